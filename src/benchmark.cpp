@@ -0,0 +1,417 @@
+#include <memory>
+#include <functional>
+#include <string>
+#include <map>
+#include <unordered_map>
+
+#include "hashmap.hpp"
+#include "sstring.hpp"
+#include "workload.hpp"
+#include "perf_counters.hpp"
+#include "latency.hpp"
+
+/*
+ * Workload driven benchmark harness.
+ *
+ * Every registered table gets the same precomputed stream of operations (see workload.hpp),
+ * so results for different tables/hash policies are directly comparable. Examples:
+ *
+ *   ./benchmark --key=int --mix=50:50:0 --load-factors=0.5,0.85,0.95 --format=csv --output=base.csv
+ *   ./benchmark --key=int --mix=50:50:0 --load-factors=0.5,0.85,0.95 --baseline=base.csv
+ *   ./benchmark --key=sstring --tables=sstring_hashmap_quadratic,std_unordered_map --keys=1000000
+ *   ./benchmark --key=int --mix=0:100:0 --hit-ratio=1 --distribution=hotspot --hot-set=0.01:0.6
+ *   ./benchmark --key=int --key-set=strided --stride=1024 --tables=hashmap_linear,hashmap_linear_murmur
+ *
+ * Compare mode returns 1 when at least one table regressed.
+ * Hardware counters (cycles, instructions, LLC/dTLB/branch misses per op) are added to results
+ * when perf_event_open allows them. Latency is measured in a separate pass over the same plan on
+ * a fresh table (so timers stay out of ns/op and counters): every --latency-sample op is timed on its
+ * own and p50/p90/p99/p99.9/max latency is reported per operation type.
+ * Int keys are random by default, --key-set=sequential|strided gives ids like the ones we see
+ * in production (key field is then int_sequential/int_strided) - that's where key hash policy matters.
+ */
+namespace harness
+{
+
+static inline common::int_holder make_holder(int raw)
+{
+    common::int_holder holder;
+    holder.content = raw;
+    holder.mark = false;
+    return holder;
+}
+
+static inline hashing_benchmark::sstring_holder make_holder(const std::string &raw)
+{
+    hashing_benchmark::sstring_holder holder;
+    holder.mark = false;
+    holder.content = sstrings::sstring<7>(raw.data(), raw.size());
+    return holder;
+}
+
+template<class Table>
+struct hashmap_ops
+{
+    using key_type = typename Table::key_type;
+
+    template<class Raw>
+    static key_type make(const Raw &raw) { return make_holder(raw); }
+    static void insert(Table &table, key_type &key) { table.insert(key); }
+    static bool find(Table &table, key_type &key) { return table.member(key); }
+    static void erase(Table &table, key_type &key) { table.erase(key); }
+    static double collisions(Table &table) { return table.collisions; }
+};
+
+template<class Table>
+struct experimental_hashmap_ops : hashmap_ops<Table>
+{
+    using key_type = typename Table::key_type;
+    static bool find(Table &table, key_type &key) { return table.fast_member(key); }
+};
+
+template<class Table>
+struct stl_ops
+{
+    using key_type = typename Table::key_type;
+
+    template<class Raw>
+    static key_type make(const Raw &raw) { return raw; }
+    static void insert(Table &table, key_type &key) { table.insert({key, {}}); }
+    static bool find(Table &table, key_type &key) { return table.find(key) != table.end(); }
+    static void erase(Table &table, key_type &key) { table.erase(key); }
+    static double collisions(Table &) { return -1; }
+};
+
+/*
+ * Keys are converted to table specific type before timing. Hashmap::insert moves holder into table,
+ * that's why keys for inserts have own copy (made again with table for latency pass).
+ */
+template<class Table, class Ops, class Raw>
+static workload::measurement run(const char *name, const workload::spec &config,
+                                 const workload::plan &plan, const std::vector<Raw> &pool)
+{
+    using key_type = typename Ops::key_type;
+
+    std::vector<key_type> keys, insert_keys;
+    keys.reserve(pool.size());
+    for (auto &raw : pool)
+        keys.push_back(Ops::make(raw));
+
+    std::unique_ptr<Table> table;
+    auto prepare = [&]()
+    {
+        table.reset();
+        insert_keys.clear();
+        insert_keys.reserve(plan.preload + plan.fresh);
+        for (unsigned i = 0; i < plan.preload + plan.fresh; i++)
+            insert_keys.push_back(Ops::make(pool[i]));
+        table.reset(new Table());
+        for (unsigned i = 0; i < plan.preload; i++)
+            Ops::insert(*table, insert_keys[i]);
+    };
+    prepare();
+
+    workload::measurement result;
+    result.table = name;
+    result.key = (config.key_set == "random")? config.key : config.key + "_" + config.key_set;
+    result.distribution = config.distribution;
+    result.load_factor = plan.preload*1.0f/config.capacity;
+    result.operations = plan.ops.size();
+
+    perf::counters counters;
+    const bool with_counters = config.counters && counters.any_available();
+
+    const latency::timer &timer = latency::default_timer();
+    const char *op_names[] = {"insert", "member", "erase"};
+    latency::histogram histograms[3];
+
+    auto execute = [&](const workload::operation &op)
+    {
+        if (op.type == 'I')
+            Ops::insert(*table, insert_keys[op.key]);
+        else if (op.type == 'M')
+            result.hits += Ops::find(*table, keys[op.key]);
+        else
+            Ops::erase(*table, keys[op.key]);
+    };
+
+    const double collisions_before = Ops::collisions(*table);
+    if (with_counters)
+        counters.start();
+    uint64_t t0 = workload::realtime_now();
+    for (auto &op : plan.ops)
+        execute(op);
+    uint64_t t1 = workload::realtime_now();
+    if (with_counters)
+        counters.stop();
+    result.time_ns = t1 - t0;
+    if (collisions_before >= 0)
+        result.collisions_per_op = (Ops::collisions(*table) - collisions_before)/result.operations;
+
+    if (config.latency_sample)
+    {
+        const unsigned hits = result.hits;
+        prepare();
+        unsigned countdown = config.latency_sample;
+        for (auto &op : plan.ops)
+        {
+            if (--countdown == 0)
+            {
+                countdown = config.latency_sample;
+                const uint64_t ticks0 = timer.start();
+                execute(op);
+                const uint64_t ticks1 = timer.stop();
+                histograms[(op.type == 'I')? 0 : (op.type == 'M')? 1 : 2].record(timer.to_ns(ticks1 - ticks0));
+            }
+            else
+                execute(op);
+        }
+        result.hits = hits;
+    }
+
+    for (unsigned i = 0; with_counters && i < perf::counters_number; i++)
+    {
+        const auto c = static_cast<perf::counter>(i);
+        if (counters.available(c))
+            result.metrics.push_back({std::string(perf::counters::name(c)) + "/op",
+                                      counters.value(c)*1.0/result.operations});
+    }
+
+    for (auto &op : plan.ops)
+    {
+        result.inserts += (op.type == 'I');
+        result.members += (op.type == 'M');
+        result.erases += (op.type == 'E');
+    }
+    for (unsigned i = 0; i < 3; i++)
+    {
+        if (histograms[i].count() == 0)
+            continue;
+        const std::string op = op_names[i];
+        result.metrics.push_back({op + "_p50_ns", histograms[i].percentile(50.0)});
+        result.metrics.push_back({op + "_p90_ns", histograms[i].percentile(90.0)});
+        result.metrics.push_back({op + "_p99_ns", histograms[i].percentile(99.0)});
+        result.metrics.push_back({op + "_p99.9_ns", histograms[i].percentile(99.9)});
+        result.metrics.push_back({op + "_max_ns", histograms[i].max()});
+    }
+    return result;
+}
+
+template<unsigned Size>
+struct int_tables
+{
+    template<class Runner>
+    static void for_each(Runner &&runner)
+    {
+        using namespace common;
+        runner.template run<Hashmap<Size, int_holder, Limited_quadratic_hash>,
+                hashmap_ops<Hashmap<Size, int_holder, Limited_quadratic_hash>>>("hashmap_quadratic");
+        runner.template run<Hashmap<Size, int_holder, Limited_linear_hash>,
+                hashmap_ops<Hashmap<Size, int_holder, Limited_linear_hash>>>("hashmap_linear");
+        runner.template run<Hashmap<Size, int_holder, Linear_hash>,
+                hashmap_ops<Hashmap<Size, int_holder, Linear_hash>>>("hashmap_linear_ll");
+        runner.template run<Hashmap<Size, int_holder, Limited_quadratic_hash, Murmur_hash>,
+                hashmap_ops<Hashmap<Size, int_holder, Limited_quadratic_hash, Murmur_hash>>>("hashmap_quadratic_murmur");
+        runner.template run<Hashmap<Size, int_holder, Limited_linear_hash, Murmur_hash>,
+                hashmap_ops<Hashmap<Size, int_holder, Limited_linear_hash, Murmur_hash>>>("hashmap_linear_murmur");
+        runner.template run<Hashmap<Size, int_holder, Limited_quadratic_hash, Multiply_xorshift_hash>,
+                hashmap_ops<Hashmap<Size, int_holder, Limited_quadratic_hash, Multiply_xorshift_hash>>>(
+                "hashmap_quadratic_mulxor");
+        runner.template run<Hashmap<Size, int_holder, Limited_linear_hash, Multiply_xorshift_hash>,
+                hashmap_ops<Hashmap<Size, int_holder, Limited_linear_hash, Multiply_xorshift_hash>>>(
+                "hashmap_linear_mulxor");
+#ifdef __SSE4_2__
+        runner.template run<Hashmap<Size, int_holder, Limited_quadratic_hash, Crc32c_hash>,
+                hashmap_ops<Hashmap<Size, int_holder, Limited_quadratic_hash, Crc32c_hash>>>("hashmap_quadratic_crc32c");
+        runner.template run<Hashmap<Size, int_holder, Limited_linear_hash, Crc32c_hash>,
+                hashmap_ops<Hashmap<Size, int_holder, Limited_linear_hash, Crc32c_hash>>>("hashmap_linear_crc32c");
+#endif
+        runner.template run<Hashmap<Size, int_holder, Double_hash>,
+                hashmap_ops<Hashmap<Size, int_holder, Double_hash>>>("hashmap_double");
+        // h1 has only p different values, so with bigger tables it degenerates to one long island
+        if (Size <= p)
+            runner.template run<Hashmap<Size, int_holder, Limited_linear_hash_prime>,
+                    hashmap_ops<Hashmap<Size, int_holder, Limited_linear_hash_prime>>>("hashmap_linear_prime");
+        runner.template run<ExperimentalHashmap<Size>,
+                experimental_hashmap_ops<ExperimentalHashmap<Size>>>("experimental_hashmap");
+        runner.template run<std::map<int, int_holder>,
+                stl_ops<std::map<int, int_holder>>>("std_map");
+        runner.template run<std::unordered_map<int, int_holder>,
+                stl_ops<std::unordered_map<int, int_holder>>>("std_unordered_map");
+    }
+};
+
+template<unsigned Size>
+struct sstring_tables
+{
+    template<class Runner>
+    static void for_each(Runner &&runner)
+    {
+        using namespace common;
+        using hashing_benchmark::sstring_holder;
+        runner.template run<hashing_benchmark::SStringHashmap<Size>,
+                hashmap_ops<hashing_benchmark::SStringHashmap<Size>>>("sstring_hashmap_quadratic");
+        runner.template run<Hashmap<Size, sstring_holder, Limited_linear_hash>,
+                hashmap_ops<Hashmap<Size, sstring_holder, Limited_linear_hash>>>("sstring_hashmap_linear");
+        runner.template run<hashing_benchmark::ExperimentalSStringHashmap<Size>,
+                experimental_hashmap_ops<hashing_benchmark::ExperimentalSStringHashmap<Size>>>(
+                "experimental_sstring_hashmap");
+        runner.template run<std::map<std::string, std::string>,
+                stl_ops<std::map<std::string, std::string>>>("std_map");
+        runner.template run<std::unordered_map<std::string, std::string>,
+                stl_ops<std::unordered_map<std::string, std::string>>>("std_unordered_map");
+    }
+};
+
+template<class Raw>
+struct runner
+{
+    const workload::spec &config;
+    const workload::plan &plan;
+    const std::vector<Raw> &pool;
+    std::vector<workload::measurement> &results;
+
+    template<class Table, class Ops>
+    void run(const char *name)
+    {
+        if (!workload::selected(config, name))
+            return;
+        results.push_back(harness::run<Table, Ops>(name, config, plan, pool));
+        fprintf(stderr, "%s load = %.3f done\n", name, results.back().load_factor);
+    }
+};
+
+struct lister
+{
+    template<class Table, class Ops>
+    void run(const char *name)
+    {
+        printf("%s\n", name);
+    }
+};
+
+static int random_int_key()
+{
+    constexpr unsigned uniwersum_size {1000000000};
+    return rand()%uniwersum_size;
+}
+
+/*
+ * Sequential/strided ids, generator state lives in lambda so every pool starts from 1.
+ */
+static std::function<int()> int_key_generator(const workload::spec &config)
+{
+    if (config.key_set == "random")
+        return random_int_key;
+    const unsigned stride = (config.key_set == "sequential")? 1 : config.stride;
+    unsigned next = 1;
+    return [stride, next]() mutable
+    {
+        const int key = static_cast<int>(next & 0x7fffffff);
+        next += stride;
+        return key;
+    };
+}
+
+static std::string random_sstring_key()
+{
+    std::string result(7, ' ');
+    for (unsigned i = 0; i < result.size(); i++)
+        result[i] = rand()%128;
+    return result;
+}
+
+template<template<unsigned> class Tables, class Raw, class Generator>
+static bool run_all(const workload::spec &config, Generator &&generator,
+                    std::vector<workload::measurement> &results)
+{
+    std::vector<unsigned> preloads;
+    if (config.keys > 0)
+        preloads.push_back(config.keys);
+    else
+        for (auto load_factor : config.load_factors)
+            preloads.push_back(load_factor*config.capacity);
+
+    for (auto preload : preloads)
+    {
+        srand(config.seed);
+        const workload::plan plan = workload::make_plan(config, preload);
+        if (plan.preload + plan.fresh > workload::max_load_factor*config.capacity)
+        {
+            fprintf(stderr, "skipped: preload = %u + inserts = %u exceeds max load factor %f of capacity %u\n",
+                    plan.preload, plan.fresh, workload::max_load_factor, config.capacity);
+            continue;
+        }
+        // copy, so stateful (sequential/strided) generators start from the same key for every load factor
+        auto generate = generator;
+        const auto pool = workload::make_key_pool<Raw>(plan.pool_size, generate);
+
+        runner<Raw> each {config, plan, pool, results};
+        switch (config.capacity)
+        {
+        case 100003: Tables<100003>::for_each(each); break;
+        case 200003: Tables<200003>::for_each(each); break;
+        case 2000003: Tables<2000003>::for_each(each); break;
+        case 4000037: Tables<4000037>::for_each(each); break;
+        case 10000019: Tables<10000019>::for_each(each); break;
+        case 50000021: Tables<50000021>::for_each(each); break;
+        default:
+            fprintf(stderr, "capacity %u not supported\n", config.capacity);
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    workload::spec config;
+    if (!workload::parse(argc, argv, config))
+    {
+        workload::usage(argv[0]);
+        return 2;
+    }
+
+    if (config.list)
+    {
+        printf("int keys:\n");
+        harness::int_tables<100003>::for_each(harness::lister());
+        printf("sstring keys:\n");
+        harness::sstring_tables<100003>::for_each(harness::lister());
+        return 0;
+    }
+
+    std::vector<workload::measurement> results;
+    const bool ok = (config.key == "int")?
+                harness::run_all<harness::int_tables, int>(config, harness::int_key_generator(config), results) :
+                harness::run_all<harness::sstring_tables, std::string>(config, harness::random_sstring_key,
+                                                                       results);
+    if (!ok)
+        return 2;
+
+    FILE *out = config.output.empty()? stdout : fopen(config.output.c_str(), "w");
+    if (!out)
+    {
+        fprintf(stderr, "can't open %s\n", config.output.c_str());
+        return 2;
+    }
+    workload::report(config, results, out);
+    if (out != stdout)
+        fclose(out);
+
+    if (!config.baseline.empty())
+    {
+        std::vector<workload::measurement> baseline;
+        if (!workload::read_baseline(config.baseline, baseline))
+        {
+            fprintf(stderr, "can't read baseline %s\n", config.baseline.c_str());
+            return 2;
+        }
+        const unsigned regressions = workload::compare(config, results, baseline);
+        printf("regressions = %u\n", regressions);
+        return (regressions > 0)? 1 : 0;
+    }
+    return 0;
+}
@@ -1,3 +1,9 @@
+#include <iterator>
+#include <memory>
+#include <set>
+#include <limits>
+#include <climits>
+
 #include "hashmap.hpp"
 
 namespace basics
@@ -73,6 +79,815 @@ static void basic_test_case()
            inserts_counter, members_counter, members_hits, stl_members_hits);
 }
 
+/*
+ * I+M+E against std::map. Small uniwersum so the same keys are erased and inserted again
+ * many times and probe chains are full of tombstones.
+ */
+static void erase_test_case()
+{
+    printf("\n%s\n\n", __FUNCTION__);
+    srand(time(nullptr));
+
+    constexpr unsigned operations_number {100000};
+    constexpr unsigned uniwersum_size {400};
+
+    unsigned members_hits {0};
+    unsigned stl_members_hits {0};
+
+    hashmap.reset();
+    stl_map.clear();
+
+    common::int_holder basic_config;
+    basic_config.mark = false;
+
+    for (unsigned i = 0; i < operations_number; i++)
+    {
+        const unsigned dice = rand()%3;
+        basic_config.content = (rand()%uniwersum_size);
+
+        if (dice == 0)
+        {
+            hashmap.insert(basic_config);
+            stl_map[basic_config.content] = basic_config;
+            assert(hashmap.member(basic_config));
+        }
+        else if (dice == 1)
+        {
+            hashmap.erase(basic_config);
+            stl_map.erase(basic_config.content);
+            assert(!hashmap.member(basic_config));
+        }
+        else
+        {
+            const bool hit = hashmap.member(basic_config);
+            const bool stl_hit = (stl_map.find(basic_config.content) != stl_map.end());
+            assert(hit == stl_hit);
+            members_hits += hit;
+            stl_members_hits += stl_hit;
+        }
+        assert(hashmap.size() == stl_map.size());
+    }
+    printf("hits = %d, stl hits = %d, hashmap.size = %d\n", members_hits, stl_members_hits, hashmap.size());
+    assert(members_hits == stl_members_hits);
+    printf("OK :)\n");
+}
+
+/*
+ * Sequential and strided ids with every key hash policy: home slot must be in [0, m), every
+ * inserted key must be found, keys between them must not. Collisions per insert are only printed,
+ * for identity hash with prime m they are low anyway.
+ */
+template<class KeyHash>
+static void key_hash_test_case(const char *name, unsigned stride)
+{
+    using table_type = common::Hashmap<100003, common::int_holder, common::Limited_linear_hash, KeyHash>;
+    constexpr unsigned keys_number {80000};
+
+    std::unique_ptr<table_type> table(new table_type());
+    common::int_holder c;
+    c.mark = false;
+
+    for (unsigned i = 0; i < keys_number; i++)
+    {
+        c.content = 1 + i*stride;
+        const int home = KeyHash::hash(c, table->capacity());
+        assert(home >= 0 && home < static_cast<int>(table->capacity()));
+        table->insert(c);
+    }
+    const unsigned insert_collisions = table->collisions;
+    assert(table->size() == keys_number);
+
+    for (unsigned i = 0; i < keys_number; i++)
+    {
+        c.content = 1 + i*stride;
+        assert(table->member(c));
+        if (stride > 1)
+        {
+            c.content = 1 + i*stride + stride/2;
+            assert(!table->member(c));
+        }
+    }
+    printf("%s stride = %u: collisions/insert = %.3f\n", name, stride, insert_collisions*1.0/keys_number);
+}
+
+static void key_hash_test_case()
+{
+    printf("\n%s\n\n", __FUNCTION__);
+    for (unsigned stride : {1u, 64u, 4096u})
+    {
+        key_hash_test_case<common::Holder_hash>("identity", stride);
+        key_hash_test_case<common::Murmur_hash>("murmur", stride);
+        key_hash_test_case<common::Multiply_xorshift_hash>("mulxor", stride);
+#ifdef __SSE4_2__
+        key_hash_test_case<common::Crc32c_hash>("crc32c", stride);
+#endif
+    }
+    printf("OK :)\n");
+}
+
+/*
+ * Table on heap and std::set with keys it should hold, for tests checking table against the set:
+ * fill adds random keys below key_range until there's keys_number of them, erase_random erases
+ * about 1/every of them (tombstones). Holder is what table's insert/erase/member take.
+ */
+template<class Table, class Holder = common::int_holder>
+struct table_fixture final
+{
+    using key_type = decltype(Holder::content);
+
+    std::unique_ptr<Table> table {new Table()};
+    std::set<key_type> expected;
+
+    static Holder holder_of(key_type key)
+    {
+        Holder c {};
+        c.content = key;
+        c.mark = false;
+        return c;
+    }
+
+    void insert(key_type key)
+    {
+        Holder c = holder_of(key);
+        table->insert(c);
+        expected.insert(key);
+    }
+
+    void erase(key_type key)
+    {
+        Holder c = holder_of(key);
+        table->erase(c);
+        expected.erase(key);
+    }
+
+    bool member(key_type key)
+    {
+        Holder c = holder_of(key);
+        return table->member(c);
+    }
+
+    void fill(size_t keys_number, int key_range = 1000000000)
+    {
+        while (expected.size() < keys_number)
+            insert(static_cast<key_type>(rand()%key_range));
+    }
+
+    void erase_random(unsigned every)
+    {
+        for (auto key : std::vector<key_type>(expected.begin(), expected.end()))
+            if (rand()%every == 0)
+                erase(key);
+    }
+};
+
+/*
+ * Whole key domain: extremes (0, -1, min, max - old INF included) and random keys, over 0.8 load after
+ * erases (so fast_member runs Iter3_key), member and fast_member must agree with std::set, also for misses.
+ */
+template<class Holder>
+static void key_holder_test_case(const char *name)
+{
+    using key_type = decltype(Holder::content);
+    using table_type = common::ExperimentalKeyHashmap<100003, Holder>;
+    constexpr unsigned keys_number {95000};
+
+    table_fixture<table_type, Holder> fixture;
+    auto &table = fixture.table;
+    auto &expected = fixture.expected;
+    std::vector<key_type> keys {0, static_cast<key_type>(-1), std::numeric_limits<key_type>::min(),
+                                std::numeric_limits<key_type>::max(), static_cast<key_type>(INT_MIN)};
+    while (keys.size() < 2*keys_number)
+        keys.push_back(static_cast<key_type>((static_cast<uint64_t>(rand()) << 33) ^
+                                             (static_cast<uint64_t>(rand()) << 11) ^ rand()));
+
+    for (unsigned i = 0; i < keys_number; i++)
+        fixture.insert(keys[i]);
+    for (unsigned i = 0; i < keys_number; i += 10)
+        fixture.erase(keys[i]);
+    assert(table->size() == expected.size());
+
+    for (auto key : keys)
+    {
+        Holder c = fixture.holder_of(key);
+        const bool present = expected.count(key);
+        assert(table->member(c) == present);
+        assert(table->fast_member(c) == present);
+    }
+    printf("%s: size/capacity = %.3f\n", name, table->size()*1.0/table->capacity());
+}
+
+// 64-bit keys differing only in high half must not share home slot (mixers fold it in)
+template<class KeyHash>
+static void high_bits_test_case(const char *name)
+{
+    constexpr int m {100003};
+    std::set<int> homes;
+    for (uint64_t i = 1; i <= 1000; i++)
+    {
+        common::uint64_holder c {i << 32, false};
+        homes.insert(KeyHash::hash(c, m));
+    }
+    assert(homes.size() > 980);
+    printf("%s: distinct homes of high half keys = %zu/1000\n", name, homes.size());
+}
+
+static void key_holder_test_case()
+{
+    printf("\n%s\n\n", __FUNCTION__);
+    key_holder_test_case<common::uint32_holder>("uint32_holder");
+    key_holder_test_case<common::int64_holder>("int64_holder");
+    key_holder_test_case<common::uint64_holder>("uint64_holder");
+    high_bits_test_case<common::Murmur_hash>("murmur");
+    high_bits_test_case<common::Multiply_xorshift_hash>("mulxor");
+#ifdef __SSE4_2__
+    high_bits_test_case<common::Crc32c_hash>("crc32c");
+#endif
+    printf("OK :)\n");
+}
+
+/*
+ * begin()/end() and for_each visit exactly live keys (tombstones and empty slots skipped), with SIMD
+ * live_mask (int_holder) and scalar one (key holder), from empty table to ~0.7 load.
+ */
+template<class Holder>
+static void iteration_test_case(const char *name)
+{
+    using key_type = decltype(Holder::content);
+    using table_type = common::Hashmap<100003, Holder>;
+
+    table_fixture<table_type, Holder> fixture;
+    auto &table = fixture.table;
+    auto &expected = fixture.expected;
+    auto check = [&]()
+    {
+        std::set<key_type> iterated, visited;
+        unsigned iterated_number = 0, visited_number = 0;
+        for (auto &holder : *table)
+        {
+            iterated.insert(holder.content);
+            iterated_number++;
+        }
+        table->for_each([&](Holder &holder)
+        {
+            visited.insert(holder.content);
+            visited_number++;
+        });
+        assert(iterated == expected && visited == expected);
+        assert(iterated_number == expected.size() && visited_number == expected.size());
+    };
+
+    check();
+    for (unsigned step : {10u, 1000u, 90000u})
+    {
+        for (unsigned i = 0; i < step; i++)
+            fixture.insert(static_cast<key_type>(rand()%1000000000));
+        fixture.erase_random(5);
+        check();
+    }
+    printf("%s: size/capacity = %.3f\n", name, table->size()*1.0/table->capacity());
+}
+
+static void iteration_test_case()
+{
+    printf("\n%s\n\n", __FUNCTION__);
+    iteration_test_case<common::int_holder>("int_holder");
+    iteration_test_case<common::uint64_holder>("uint64_holder");
+    printf("OK :)\n");
+}
+
+template<class Holder>
+static void erase_if_test_case(const char *name, unsigned threads)
+{
+    using key_type = decltype(Holder::content);
+    using table_type = common::Hashmap<100003, Holder>;
+
+    table_fixture<table_type, Holder> fixture;
+    auto &table = fixture.table;
+    auto &expected = fixture.expected;
+    fixture.fill(60000);
+    for (auto key : std::vector<key_type>(expected.begin(), expected.end()))
+        if (key%7 == 0)
+            fixture.erase(key);
+    const unsigned erased_one_by_one = 60000 - expected.size();
+    assert(table->tombstones() == erased_one_by_one);
+
+    // 10% of keys, no purge yet
+    auto small = [](const Holder &holder) { return holder.content%10 == 3; };
+    unsigned expected_erased = 0;
+    for (auto it = expected.begin(); it != expected.end();)
+        if (*it%10 == 3)
+        {
+            it = expected.erase(it);
+            expected_erased++;
+        }
+        else
+            ++it;
+    assert(table->erase_if(small, threads) == expected_erased);
+    assert(table->size() == expected.size());
+    assert(table->tombstones() == erased_one_by_one + expected_erased);
+
+    // keep 40% - over purge_above, tombstones are gone afterwards
+    auto kept = [](const Holder &holder) { return holder.content%10 < 4; };
+    const unsigned before = expected.size();
+    for (auto it = expected.begin(); it != expected.end();)
+        if (*it%10 >= 4)
+            it = expected.erase(it);
+        else
+            ++it;
+    assert(table->retain_if(kept, threads) == before - expected.size());
+    assert(table->size() == expected.size() && table->tombstones() == 0);
+
+    unsigned visited = 0;
+    table->for_each([&](Holder &holder)
+    {
+        assert(expected.count(holder.content));
+        visited++;
+    });
+    assert(visited == expected.size());
+    for (unsigned i = 0; i < 100000; i++)
+    {
+        const key_type key = static_cast<key_type>(rand()%1000000000);
+        assert(fixture.member(key) == (expected.count(key) != 0));
+    }
+    for (auto key : expected)
+        assert(fixture.member(key));
+    // tombstone reused by insert
+    const key_type key = *expected.begin();
+    fixture.erase(key);
+    assert(table->tombstones() == 1);
+    fixture.insert(key);
+    assert(table->tombstones() == 0 && table->size() == expected.size());
+    printf("%s, %u threads: size/capacity = %.3f\n", name, threads, table->size()*1.0/table->capacity());
+}
+
+static void erase_if_test_case()
+{
+    printf("\n%s\n\n", __FUNCTION__);
+    erase_if_test_case<common::int_holder>("int_holder", 1);
+    erase_if_test_case<common::int_holder>("int_holder", 3);
+    erase_if_test_case<common::uint64_holder>("uint64_holder", 4);
+    printf("OK :)\n");
+}
+
+template<class Holder>
+static void set_algebra_test_case(const char *name, unsigned threads)
+{
+    using key_type = decltype(Holder::content);
+    using small_type = common::Hashmap<100003, Holder>;
+    using large_type = common::Hashmap<200003, Holder>;
+
+    // keys below 200000 so a and b overlap, erases leave tombstones in probe chains
+    table_fixture<small_type, Holder> a_fixture;
+    table_fixture<large_type, Holder> b_fixture;
+    a_fixture.fill(60000, 200000);
+    a_fixture.erase_random(6);
+    b_fixture.fill(80000, 200000);
+    b_fixture.erase_random(6);
+    auto &a = a_fixture.table, &b = b_fixture.table;
+    auto &expected_a = a_fixture.expected, &expected_b = b_fixture.expected;
+
+    auto check = [&](auto &&operation, auto &&expected_operation)
+    {
+        std::unique_ptr<large_type> result(new large_type());
+        std::set<key_type> expected, got;
+        operation(*result);
+        expected_operation(std::inserter(expected, expected.end()));
+        result->for_each([&](Holder &holder) { got.insert(holder.content); });
+        assert(got == expected && result->size() == expected.size());
+    };
+    check([&](large_type &result) { a->intersect(*b, result, threads); },
+          [&](auto out) { std::set_intersection(expected_a.begin(), expected_a.end(), expected_b.begin(), expected_b.end(), out); });
+    check([&](large_type &result) { b->intersect(*a, result, threads); },
+          [&](auto out) { std::set_intersection(expected_a.begin(), expected_a.end(), expected_b.begin(), expected_b.end(), out); });
+    check([&](large_type &result) { a->unite(*b, result, threads); },
+          [&](auto out) { std::set_union(expected_a.begin(), expected_a.end(), expected_b.begin(), expected_b.end(), out); });
+    check([&](large_type &result) { a->difference(*b, result, threads); },
+          [&](auto out) { std::set_difference(expected_a.begin(), expected_a.end(), expected_b.begin(), expected_b.end(), out); });
+    check([&](large_type &result) { b->difference(*a, result, threads); },
+          [&](auto out) { std::set_difference(expected_b.begin(), expected_b.end(), expected_a.begin(), expected_a.end(), out); });
+    printf("%s, %u threads: |a| = %u, |b| = %u\n", name, threads, a->size(), b->size());
+}
+
+static void set_algebra_test_case()
+{
+    printf("\n%s\n\n", __FUNCTION__);
+    set_algebra_test_case<common::int_holder>("int_holder", 1);
+    set_algebra_test_case<common::int_holder>("int_holder", 3);
+    set_algebra_test_case<common::uint64_holder>("uint64_holder", 2);
+    printf("OK :)\n");
+}
+
+template<class Holder>
+static void aggregation_test_case(const char *name)
+{
+    using table_type = common::AggregationHashmap<100003, Holder>;
+    using content_type = typename table_type::content_type;
+
+    std::unique_ptr<table_type> upserted(new table_type()), aggregated(new table_type()), merged(new table_type());
+    std::map<content_type, uint64_t> expected;
+    std::vector<content_type> keys;
+    for (unsigned i = 0; i < 80000; i++)
+    {
+        // skewed: few keys are hit often
+        const content_type key = (rand()%4 == 0)? rand()%100 : static_cast<content_type>(rand()%1000000000)*7919;
+        keys.push_back(key);
+        expected[key]++;
+    }
+    for (auto key : keys)
+        upserted->upsert(key);
+    aggregated->aggregate(keys.data(), keys.size());
+    // two halves counted separately, second one merged into first
+    std::unique_ptr<table_type> second_half(new table_type());
+    merged->aggregate(keys.data(), keys.size()/2);
+    second_half->aggregate(keys.data() + keys.size()/2, keys.size() - keys.size()/2);
+    merged->merge(*second_half);
+
+    for (auto *table : {upserted.get(), aggregated.get(), merged.get()})
+    {
+        assert(table->size() == expected.size());
+        for (auto &[key, count] : expected)
+            assert(table->count(key) == count);
+        unsigned visited = 0;
+        table->for_each([&](Holder &holder)
+        {
+            assert(expected.at(holder.content) == holder.counter);
+            visited++;
+        });
+        assert(visited == expected.size());
+        assert(table->count(3) == (expected.count(3)? expected[3] : 0));
+    }
+
+    // erased key starts from 0 again, on its tombstone
+    const content_type key = keys.front();
+    Holder c {};
+    c.content = key;
+    c.mark = false;
+    upserted->erase(c);
+    assert(upserted->count(key) == 0 && upserted->tombstones() == 1);
+    assert(upserted->upsert(key, 5) == 5 && upserted->upsert(key, 2) == 7);
+    assert(upserted->tombstones() == 0 && upserted->size() == expected.size());
+    printf("%s: %zu keys, size/capacity = %.3f\n", name, expected.size(), upserted->size()*1.0/upserted->capacity());
+}
+
+static void aggregation_test_case()
+{
+    printf("\n%s\n\n", __FUNCTION__);
+    aggregation_test_case<common::uint32_count_holder>("uint32_count_holder");
+    aggregation_test_case<common::uint64_count_holder>("uint64_count_holder");
+    printf("OK :)\n");
+}
+
+template<class Holder>
+static void hash_join_test_case(const char *name, unsigned threads)
+{
+    using join_type = common::HashJoin<100003, Holder>;
+    using content_type = typename join_type::content_type;
+
+    std::unique_ptr<join_type> join(new join_type());
+    std::vector<content_type> build_keys, probe_keys;
+    for (unsigned i = 0; i < 50000; i++)
+        build_keys.push_back(static_cast<content_type>(rand()%30000)*104729);
+    for (unsigned i = 0; i < 200000; i++)
+        probe_keys.push_back(static_cast<content_type>(rand()%60000)*104729);
+
+    std::multimap<content_type, uint32_t> rows_of_key;
+    for (uint32_t row = 0; row < build_keys.size(); row++)
+        rows_of_key.emplace(build_keys[row], row);
+    std::set<std::pair<uint32_t, uint32_t>> expected;
+    for (uint32_t row = 0; row < probe_keys.size(); row++)
+    {
+        auto range = rows_of_key.equal_range(probe_keys[row]);
+        for (auto it = range.first; it != range.second; ++it)
+            expected.emplace(it->second, row);
+    }
+
+    join->build(build_keys.data(), build_keys.size());
+    assert(join->size() == std::set<content_type>(build_keys.begin(), build_keys.end()).size());
+    std::vector<common::join_match> out(expected.size() + 10);
+    const size_t matches = join->probe(probe_keys.data(), probe_keys.size(), out.data(), out.size(), threads);
+    assert(matches == expected.size());
+    std::set<std::pair<uint32_t, uint32_t>> got;
+    for (size_t k = 0; k < matches; k++)
+        got.emplace(out[k].build_row, out[k].probe_row);
+    assert(got == expected);
+
+    // too small out - all matches are counted, out is filled with some of them
+    std::vector<common::join_match> small_out(1000);
+    assert(join->probe(probe_keys.data(), probe_keys.size(), small_out.data(), small_out.size(), threads) == expected.size());
+    for (auto &match : small_out)
+        assert(expected.count({match.build_row, match.probe_row}));
+
+    // build again with other keys drops previous rows
+    join->build(probe_keys.data(), 10);
+    assert(join->build_rows() == 10);
+    assert(join->probe(build_keys.data(), 0, out.data(), out.size(), threads) == 0);
+    printf("%s, %u threads: %zu matches\n", name, threads, matches);
+}
+
+static void hash_join_test_case()
+{
+    printf("\n%s\n\n", __FUNCTION__);
+    hash_join_test_case<common::uint32_row_holder>("uint32_row_holder", 1);
+    hash_join_test_case<common::uint32_row_holder>("uint32_row_holder", 3);
+    hash_join_test_case<common::uint64_row_holder>("uint64_row_holder", 2);
+    printf("OK :)\n");
+}
+
+template<class Holder>
+static void partitioned_test_case(const char *name)
+{
+    using table_type = common::PartitionedHashmap<4, 100003, Holder>;
+    using content_type = typename table_type::content_type;
+
+    table_fixture<table_type, Holder> fixture;
+    auto &table = fixture.table;
+    auto &expected = fixture.expected;
+    std::vector<content_type> keys;
+    for (unsigned i = 0; i < 600000; i++)
+        keys.push_back(static_cast<content_type>(rand()%1000000000));
+    table->insert_bulk(keys.data(), keys.size()/2);
+    expected.insert(keys.begin(), keys.begin() + keys.size()/2);
+    assert(table->size() == expected.size());
+
+    // single inserts and erases go to the same partitions as bulk ones
+    for (unsigned i = 0; i < 50000; i++)
+    {
+        fixture.insert(keys[keys.size()/2 + i]);
+        fixture.erase(keys[i]);
+    }
+    assert(table->size() == expected.size());
+
+    std::unique_ptr<bool[]> results(new bool[keys.size()]);
+    table->member_bulk(keys.data(), keys.size(), results.get());
+    for (size_t k = 0; k < keys.size(); k++)
+    {
+        assert(results[k] == (expected.count(keys[k]) != 0));
+        assert(fixture.member(keys[k]) == results[k]);
+    }
+    unsigned visited = 0;
+    table->for_each([&](Holder &holder)
+    {
+        assert(expected.count(holder.content));
+        visited++;
+    });
+    assert(visited == expected.size());
+
+    // too many keys for partitions of 500 - nothing is inserted
+    std::unique_ptr<common::PartitionedHashmap<2, 500, Holder>> small(new common::PartitionedHashmap<2, 500, Holder>());
+    bool thrown = false;
+    try
+    {
+        small->insert_bulk(keys.data(), 3000);
+    }
+    catch (const std::length_error &)
+    {
+        thrown = true;
+    }
+    assert(thrown && small->size() == 0);
+    small->insert_bulk(keys.data(), 1000);
+    assert(small->size() == std::set<content_type>(keys.begin(), keys.begin() + 1000).size());
+    printf("%s: size/capacity = %.3f\n", name, table->size()*1.0/table->capacity());
+}
+
+static void partitioned_test_case()
+{
+    printf("\n%s\n\n", __FUNCTION__);
+    partitioned_test_case<common::int_holder>("int_holder");
+    partitioned_test_case<common::uint64_holder>("uint64_holder");
+    printf("OK :)\n");
+}
+
+template<unsigned MaxProbe>
+static void bounded_test_case(unsigned keys_number)
+{
+    using table_type = common::BoundedHashmap<200003, MaxProbe>;
+
+    table_fixture<table_type> fixture;
+    auto &table = fixture.table;
+    auto &expected = fixture.expected;
+    fixture.fill(keys_number);
+    assert(table->size() == expected.size());
+    const unsigned full_stash = table->stash_size();
+
+    // erase from windows and from stash, insert again - window slots are reused
+    fixture.erase_random(3);
+    assert(table->size() == expected.size());
+    for (unsigned i = 0; i < 20000; i++)
+        fixture.insert(rand()%1000000000);
+    assert(table->size() == expected.size());
+
+    common::int_holder c;
+    c.mark = false;
+
+    for (auto key : expected)
+    {
+        c.content = key;
+        assert(table->member(c));
+    }
+    for (unsigned i = 0; i < 200000; i++)
+    {
+        c.content = rand()%1000000000;
+        assert(table->member(c) == (expected.count(c.content) != 0));
+    }
+    // keys with home slot at the end of table, window goes to padding
+    for (int key : {200002, 400005, 200003*7 - 1})
+    {
+        if (expected.count(key))
+            continue;
+        c.content = key;
+        table->insert(c);
+        assert(table->member(c));
+        table->erase(c);
+        assert(!table->member(c));
+    }
+    // negative keys: -1 is INF of empty slots, others have negative home
+    for (int key : {-1, -2, -200003, INT_MIN})
+    {
+        c.content = key;
+        bool thrown = false;
+        try
+        {
+            table->insert(c);
+        }
+        catch (const std::out_of_range &)
+        {
+            thrown = true;
+        }
+        assert(thrown && !table->member(c));
+        table->erase(c);
+    }
+    assert(table->size() == expected.size());
+    printf("MaxProbe = %u, %u keys: stash = %u keys\n", MaxProbe, keys_number, full_stash);
+}
+
+static void bounded_test_case()
+{
+    printf("\n%s\n\n", __FUNCTION__);
+    bounded_test_case<4>(100000);
+    bounded_test_case<8>(190000);
+    bounded_test_case<32>(190000);
+    printf("OK :)\n");
+}
+
+/*
+ * Bucketized_quadratic_hash probes: all slots of home line first, every probe in used lines, first
+ * lines_of(m) steps visit every line of every allowed size (253 keys of one home line fit in
+ * Hashmap<500>). Table is filled over 0.8 (fast_member runs Iter_line) with tombstones, member and
+ * fast_member must agree with std::set.
+ */
+static void bucketized_test_case()
+{
+    printf("\n%s\n\n", __FUNCTION__);
+    using hash = common::Bucketized_quadratic_hash;
+    using table_type = common::ExperimentalHashmap<200003, hash>;
+    constexpr int m {200003};
+    constexpr int lines {hash::lines_of(m)};
+
+    for (int k : {0, 11, 12, 5000, lines*hash::line_slots - 1, m - 12, m - 1})
+    {
+        std::set<int> line;
+        for (int j = 0; j < 1000; j++)
+        {
+            const int i = hash::h(k, j, m);
+            assert(i >= 0 && i < lines*hash::line_slots);
+            if (j < hash::line_slots)
+            {
+                assert(i/hash::line_slots == (k/hash::line_slots)%lines);
+                line.insert(i);
+            }
+        }
+        assert(hash::h(k, 0, m) == k || k >= lines*hash::line_slots);
+        assert(line.size() == hash::line_slots);
+    }
+
+    for (int size : {50000021, 10000019, 4000037, 2000003, 200003, 100003, 500})
+    {
+        const int size_lines = hash::lines_of(size);
+        assert(size_lines*hash::line_slots <= size && size_lines%4 == 3);
+        for (int d = 2; d*d <= size_lines; d++)
+            assert(size_lines%d != 0);
+        for (int home_line : {0, size_lines/2, size_lines - 1})
+        {
+            std::vector<bool> visited(size_lines, false);
+            for (int t = 0; t < size_lines; t++)
+                visited[hash::line(home_line, t, size_lines)] = true;
+            assert(std::find(visited.begin(), visited.end(), false) == visited.end());
+        }
+    }
+
+    {
+        // all keys have home line 0, chain goes through most of the 31 lines
+        std::unique_ptr<common::Hashmap<500, common::int_holder, hash>> small(
+                new common::Hashmap<500, common::int_holder, hash>());
+        common::int_holder c;
+        c.mark = false;
+        for (int key = 0; key < 253; key++)
+        {
+            c.content = (key/hash::line_slots)*500 + key%hash::line_slots;
+            small->insert(c);
+        }
+        assert(small->size() == 253);
+        for (int key = 0; key < 253; key++)
+        {
+            c.content = (key/hash::line_slots)*500 + key%hash::line_slots;
+            assert(small->member(c));
+        }
+    }
+
+    table_fixture<table_type> fixture;
+    fixture.fill(185000);
+    fixture.erase_random(20);
+    auto &table = fixture.table;
+    auto &expected = fixture.expected;
+    assert(table->size() == expected.size() && table->size() > 4*table->capacity()/5);
+    common::int_holder c;
+    c.mark = false;
+    for (auto key : expected)
+    {
+        c.content = key;
+        assert(table->member(c) && table->fast_member<common::Iter_line>(c));
+    }
+    for (unsigned i = 0; i < 200000; i++)
+    {
+        c.content = rand()%1000000000;
+        const bool present = expected.count(c.content);
+        assert(table->member(c) == present);
+        assert(table->fast_member<common::Iter_line>(c) == present);
+    }
+    printf("size/capacity = %.3f, collisions = %u\n", table->size()*1.0/table->capacity(), table->collisions);
+    printf("OK :)\n");
+}
+
+/*
+ * Every kernel of adaptive_member (avx2 only when CPU has it) stops on the same slot as
+ * process_search__true while table fills up to 0.95 with tombstones, adaptive_member agrees with
+ * std::set over many epochs and its counters add up to number of calls, sampling stops on stable
+ * table and starts again when its size moves.
+ */
+static void adaptive_test_case()
+{
+    printf("\n%s\n\n", __FUNCTION__);
+    using table_type = common::ExperimentalHashmap<100003>;
+    const unsigned kernels = common::has_avx2()? common::probe_kernels : common::probe_kernels - 1;
+
+    table_fixture<table_type> fixture;
+    auto &table = fixture.table;
+    auto &expected = fixture.expected;
+    common::int_holder c;
+    c.mark = false;
+    uint64_t calls {0};
+    for (unsigned load : {10, 50, 80, 90, 95})
+    {
+        fixture.fill(load*table->capacity()/100);
+        fixture.erase_random(20);
+        for (unsigned i = 0; i < 100000; i++)
+        {
+            c.content = (i%2 == 0)? rand()%1000000000 : *expected.lower_bound(rand()%(*expected.rbegin()));
+            const bool present = expected.count(c.content);
+            const int slot = table->probe(common::probe_kernel::scalar, c);
+            for (unsigned k = 1; k < kernels; k++)
+                assert(table->probe(static_cast<common::probe_kernel>(k), c) == slot);
+            assert(table->adaptive_member(c) == present);
+            calls++;
+        }
+        const common::kernel_counters counters = table->adaptive_counters();
+        uint64_t counted {0}, samples {0};
+        for (unsigned k = 0; k < common::probe_kernels; k++)
+        {
+            counted += counters.calls[k];
+            samples += counters.samples[k];
+            assert(k < kernels || counters.calls[k] == 0);
+        }
+        assert(counted == calls);
+        assert(samples%table_type::sample_run == 0);
+        assert(samples/(table_type::sample_run*table_type::sample_runs*kernels) == counters.epochs);
+        assert(static_cast<unsigned>(counters.active) < kernels);
+        printf("load %u%%: active = %s, epochs = %u, switches = %u\n", load, common::kernel_name(counters.active),
+               counters.epochs, counters.switches);
+    }
+
+    // stable table settles (sampling stops), n moved by over Size/16 starts epochs again
+    auto run = [&](unsigned calls_number)
+    {
+        for (unsigned i = 0; i < calls_number; i++)
+        {
+            c.content = rand()%1000000000;
+            assert(table->adaptive_member(c) == (expected.count(c.content) != 0));
+        }
+    };
+    for (unsigned i = 0; (i < 64) && !table->adaptive_counters().settled; i++)
+        run(1u << 18);
+    const common::kernel_counters settled = table->adaptive_counters();
+    assert(settled.settled);
+    run(2*(table_type::epoch_calls << table_type::max_backoff));
+    assert(table->adaptive_counters().epochs == settled.epochs);
+    fixture.erase_random(4);
+    run(2*(table_type::epoch_calls << table_type::max_backoff));
+    assert(table->adaptive_counters().epochs > settled.epochs);
+    printf("settled after %u epochs\n", settled.epochs);
+    printf("OK :)\n");
+}
+
 }
 
 
@@ -373,6 +1188,18 @@ static void real_test_case_theory_vs_practice(float alpha, bool record_hits)
 int main()
 {
     basics::basic_test_case();
+    basics::erase_test_case();
+    basics::key_hash_test_case();
+    basics::key_holder_test_case();
+    basics::iteration_test_case();
+    basics::erase_if_test_case();
+    basics::set_algebra_test_case();
+    basics::aggregation_test_case();
+    basics::hash_join_test_case();
+    basics::partitioned_test_case();
+    basics::bounded_test_case();
+    basics::bucketized_test_case();
+    basics::adaptive_test_case();
     hashmap_tests::real_test_case_theory_vs_practice(0.65f, false);
     hashmap_tests::real_test_case_theory_vs_practice(0.75f, false);
     hashmap_tests::real_test_case_theory_vs_practice(0.85f, false);
@@ -0,0 +1,60 @@
+#ifndef DISTRIBUTION_HPP
+#define DISTRIBUTION_HPP
+
+#include <cmath>
+#include <cstdlib>
+
+/*
+ * Key choice distributions, used by workload (benchmark harness) and speed_tests.
+ */
+namespace workload
+{
+
+static inline double rand_uniform()
+{
+    return rand()/(RAND_MAX + 1.0);
+}
+
+/*
+ * Zipfian ranks from [0, items), rank 0 is the most popular.
+ * Gray et al. "Quickly generating billion-record synthetic databases" (the one used by YCSB).
+ * zeta(items) is computed once, O(items).
+ */
+class zipf_generator final
+{
+public:
+    zipf_generator(unsigned items_number, double skew)
+        : items(items_number), theta(skew)
+    {
+        if (items == 0)
+            return;
+        for (unsigned i = 1; i <= items; i++)
+            zetan += 1.0/std::pow(i, theta);
+        const double zeta2 = 1.0 + 1.0/std::pow(2.0, theta);
+        alpha = 1.0/(1.0 - theta);
+        eta = (1.0 - std::pow(2.0/items, 1.0 - theta))/(1.0 - zeta2/zetan);
+    }
+
+    unsigned next()
+    {
+        const double u = rand_uniform();
+        const double uz = u*zetan;
+        if (uz < 1.0)
+            return 0;
+        if (uz < 1.0 + std::pow(0.5, theta))
+            return (items > 1)? 1 : 0;
+        const unsigned rank = items*std::pow(eta*u - eta + 1.0, alpha);
+        return (rank < items)? rank : items - 1;
+    }
+
+private:
+    unsigned items;
+    double theta;
+    double zetan {0};
+    double alpha {0};
+    double eta {0};
+};
+
+}
+
+#endif // DISTRIBUTION_HPP
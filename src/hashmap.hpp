@@ -2,6 +2,15 @@
 #define HASHMAP_HPP
 
 #include <cstdio>
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
 #include <utility>
 #include <cassert>
 #include <ctime>
@@ -11,8 +20,13 @@
 #include <unordered_map>
 #include <algorithm>
 #include <cmath>
+#include <thread>
 #include <emmintrin.h>
 #include <smmintrin.h>
+#include <immintrin.h>
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
 
 /*
  * iteration 0.
@@ -277,97 +291,1742 @@ To
    * iteration 6:
      - fast_member is experimental
 
+   * iteration 7:
+     - key hash policy (4th template parameter) separated from probing policy (3rd one).
+       int_holder::hash is identity (content % m) so for sequential or strided ids home slots
+       are as regular as ids - only prime size saves us. Holder_hash keeps old behaviour,
+       Murmur_hash (fmix32), Multiply_xorshift_hash and Crc32c_hash (SSE4.2) mix key first
+       and map it to [0, m) by multiply-shift instead of modulo.
+     - ./benchmark --capacity=2000003 --load-factors=0.85 --key-set=... --stride=1024, ns/op:
+                          random   sequential   strided
+         linear            363        81          98
+         linear_murmur     345       332         372
+         linear_mulxor     347       272         275
+         linear_crc32c     353       231         182
+       With prime m identity is still the best for ids: i*stride mod m is a permutation, no collisions
+       and neighbour ids are neighbours in table. Mixers cost ~0 on random keys and keep tables safe
+       when size stops being prime, so static_assert stays as it is for now.
+
+   * iteration 8:
+     - int_holder can't hold INF (-1) nor negative keys (content % m < 0) and Iter3 takes sign bit as
+       empty. basic_key_holder<Key> (uint32_holder, int64_holder, uint64_holder) has occupied flag
+       instead, so every key is legal, hash is unsigned key % m. Iter3_key is Iter3 for them:
+       occupied flags of 4 probes -> 4-bit mask, keys compared by pcmpeqd (4 x 32) / pcmpeqq (2 x 64).
+       ExperimentalKeyHashmap picks it like ExperimentalHashmap picks Iter3.
+     - speed_tests, 190000 keys in 200003 table (0.95), 1024 queries (misses), ns per query:
+                          member   fast_member
+         int_holder        129       124   (Iter3)
+         uint32_holder     112        95   (Iter3_key)
+         int64_holder      118       133
+         uint64_holder     125       122
+       32-bit keys are faster than Iter3 (one compare for 4 slots), 64-bit ones are on par with member.
+
+   * iteration 9:
+     - begin()/end() and for_each(fn) over live slots. Blocks of 16 slots -> bit mask by
+       Holder::live_mask (int_holder: pshufb of 5B slots + pcmpeqd, sstring holders: pcmpeqq),
+       scalar mask for other holders, then only set bits are visited (ctz).
+     - speed_tests benchmark__scan, 50000021 int_holder table (250MB), GB/s:
+                          loop   iterator   for_each
+         fill 0.01        2.50     3.65       3.64
+         fill 0.10        1.62     2.08       2.20
+         fill 0.50        0.64     1.40       1.53
+       (10000019 SStringHashmap, fill 0.2: loop 2.88, for_each 4.04 GB/s)
+       Loop branches on every slot and mispredicts a lot at half fill, masks have one branch per
+       live slot.
+   * iteration 10:
+     - erase_if(pred, threads, purge_above)/retain_if - scan with masks like for_each, in threads
+       chunks (block aligned), live holder with pred true gets mark (tombstone), no probing.
+       tombstones() counted by erase/erase_if, insert on tombstone gives it back, purge() rebuilds
+       table without tombstones - done by erase_if over purge_above*capacity.
+     - speed_tests benchmark__erase_if, 50000021 int_holder table with 10M keys, ms:
+                          erase loop   erase_if   erase_if + purge
+         erase 10%           195         148           479
+         erase 50%           358         227           546
+         erase 90%           492         142           558
+       Erase loop pays a probe per key (cache miss), erase_if is one pass over 250MB. Only 1 CPU
+       here, so threads > 1 weren't measured (same times with hardware_concurrency()).
+   * iteration 11:
+     - intersect/unite/difference(other, result, threads) over probe_each - live holders of one
+       table are probed in other in place, one member call per slot (own collisions counter per
+       thread, so chunks can probe concurrently).
+     - speed_tests benchmark__set_algebra, 10000019 int_holder tables, keys spread over table, ms:
+                               member loop   std::set_intersection   intersect   unite
+         |a| = 1M, |b| = 5M        60.1              32.3                58.2      183.5
+         |a| = 5M, |b| = 5M       202.1             120.9               192.0      381.9
+       (difference 61.9 / 186.3 vs member loop 62.4 / 195.3)
+       First version copied live holders into groups of 64 and probed them with member_batch:
+       72.7 / 262.7 ms intersect, 245.7 / 497.3 ms unite on the same run - gathering cost more
+       than prefetch won, member loop iterations are independent and out of order execution
+       overlaps their misses. About half of the time is scan of 50MB table (for_each alone ~20ms
+       for 1M). Sorted vectors win, but sort isn't counted. One CPU here, threads > 1 are tested
+       for correctness only, speedup isn't measured.
+   * iteration 12:
+     - AggregationHashmap - basic_count_holder (key + inline counter), upsert(key, delta) in one
+       probe sequence, aggregate(keys, n) pipelined with prefetch (for write) of next group,
+       merge(other) for per thread tables.
+     - speed_tests benchmark__aggregation, 10M zipf events over 1M items, 2000003 table, ns/event:
+                              unordered_map ++   member + insert   upsert   aggregate
+         theta 0.50                 171              23.5           35.2      22.8
+         theta 0.99                 159              22.1           34.3      15.9
+       member + insert doesn't count anything, it's there for two probes per new key. Plain upsert
+       loses to it - count holder is 10B instead of 6B and every hit dirties its line - aggregate
+       gets it back with prefetch. (per thread tables + merge, 1 thread here: 43 / 16 ns, that includes
+       construction of fresh table)
+   * iteration 13:
+     - HashJoin - build(keys) gives table of basic_row_holder (first row of key) + next chain for
+       duplicates, probe(keys, out, threads) streams probe column in prefetched groups and writes
+       join_match pairs to preallocated out (atomic add of place per 1024 matches from thread).
+     - speed_tests benchmark__hash_join, 1M build rows x 100M probe rows, 10% of probe rows match:
+                                   build        probe
+         unordered_multimap       173 ms     82.6 ns/row
+         HashJoin (2000003)        34 ms     52.1 ns/row
+       Member loop over the same table is as fast as probe (49 ns/row), with 100K build rows
+       (cached table) even a bit faster (21.6 vs 27.0 ns/row) - prefetch of next group doesn't
+       win anything over out of order execution here, like member_batch (iteration 11).
+   * iteration 14:
+     - PartitionedHashmap<RadixBits, PartitionSize> - 2^RadixBits Hashmaps routed by high bits of
+       multiplicative hash, insert_bulk/member_bulk scatter keys by partition (histogram + write
+       combining buffers of 64B) and then work partition by partition in L2.
+     - speed_tests benchmark__partitioned, 25M random keys, Hashmap<50000021> vs 512 x Hashmap<100003>
+       (both ~250MB, L2 2MB, L3 105MB), ns/key:
+                            direct   partitioned (single key)   partitioned bulk
+         insert             65-74              -                    37-38
+         member (50% hit)   74-82            77-85                  58-65
+       Bulk insert is ~2x. Bulk member gains less - half of it is the scatter (keys with indexes,
+       8B items) and results are written back in random order. Inserts/members inside partition
+       still cost ~25-35 ns (mispredicted probe loop), that is the floor here. Buffers were
+       aligned to cache lines later - no difference measurable on this machine (run to run noise
+       of +-10% is bigger), one line per partition is kept for free.
+   * iteration 15:
+     - Iter4_Broken_But_Fast is fast mostly because only its last group of 4 slots is used, so
+       compiler drops the other 7 - it reads 4 slots and answers wrong.
+       BoundedHashmap<Size, MaxProbe> makes it exact: key is in its MaxProbe quadratic window or
+       in sorted stash, member checks whole window (branchless, pcmpeqd per 4 slots, padding instead
+       of modulo) and stash behind bit filter only when window misses.
+     - speed_tests benchmark__bounded_probe, 190000 keys in 200003 table (0.95), ns per query:
+                              misses   50% hits
+         member               113.8      62.3
+         fast_member (Iter3)  124.9      77.6
+         Iter4 (wrong)         12.1      14.0
+         Bounded, 8 slots      13.4      15.6    stash 13459 keys (7%)
+         Bounded, 16 slots     20.2      21.2    stash 5497 keys
+       Window of 8 is the default - stash is large at 0.95, but filter keeps it off misses.
+   * iteration 16:
+     - Bucketized_quadratic_hash - lines of 12 slots (60B), linear inside home line, quadratic between
+       lines. Iter_line checks whole line by int_holder::stop_mask (6 loads, 6 pcmpeqd), mask rotated
+       by home offset gives the same slot as scalar probe.
+     - line steps were t + t*t over m/12 lines first - not prime, so chain reached only part of
+       table (253 keys of one home line in Hashmap<500> took 556k probes and ran out of it). Now
+       lines are prime = 3 mod 4 and steps go +-t*t, every line is reached, same speed.
+     - speed_tests benchmark__bucketized, 0.95 load, 1M query keys (19% / 50% hits), ns/query:
+                              quadratic member   Iter3   bucketized member   Iter_line
+         200003 (1MB)                90           111           345             98
+         50000021 (250MB)           516           567           651            341
+       Collisions per insert are 2x (5.5-5.9 vs 2.6) - lines fill up and a miss goes on to the next
+       line - so scalar member over bucketized lines is the slowest, but Iter_line pays one line per
+       12 probes: 1.5x faster than quadratic member once table is in DRAM, in L2 about the same.
+   * iteration 17:
+     - ExperimentalHashmap::adaptive_member - kernel (scalar, Iter3, Iter3_avx2) picked per table from
+       timed sample runs, see kernel_counters. Iter3_avx2 is Iter3 on 8 lanes with vpgatherdd and
+       no modulo (slots and steps kept in [0, m) by compare + subtract).
+     - speed_tests benchmark__adaptive, table filled from 0.3 to 0.95, 50% hits, ns/query (settled -
+       second run over the same queries, sampling stopped):
+                                  scalar   Iter3   avx2   fast_member   adaptive   settled (picked)
+         200003     0.30           19.3     31.3   11.8      21.3         12.5      11.8   (avx2)
+                    0.80           50.0     61.6   23.1      65.3         24.5      22.7   (avx2)
+                    0.95          117.7    144.9   76.6     145.0         77.1      78.1   (avx2)
+         50000021   0.30           64.1    119.5  112.5      73.9         51.9      55.3   (scalar)
+                    0.60          213.6    148.3   92.8     198.2        138.0     119.7   (avx2)
+                    0.80          352.7    404.9  163.0     386.6        128.1     118.9   (avx2)
+                    0.95          583.3    662.9  587.8     685.3        582.5     588.8   (avx2)
+       First version sampled every epoch forever - 2 x 64 calls of each losing kernel per epoch,
+       16.7 vs 13.4 ns (L2, 0.30) and 70.2 vs 64.1 ns (DRAM, 0.30) against the forced winner.
+       Settled now: in L2 within 2% of the forced winner, DRAM rows move by +-20% run to run
+       (both sides of the winner show up), so no overhead is measurable there.
+       Iter3 (4 x idiv per group) is slower than scalar in all cases but one, so n > 0.8*m rule of
+       fast_member mostly loses. avx2 wins from 0.3 in L2 but not for DRAM table at low load - 8
+       slots (8 misses) for ~1.2 probes. Timing single calls (lfence + rdtscp) picked scalar
+       everywhere - it hides overlapped loads of gather, runs of 64 calls are timed instead.
 
+
+ */
+
+namespace common
+{
+
+constexpr int INF {-1};
+
+struct int_holder final
+{
+    int content;
+    bool mark;
+
+    void init_as_empty()
+    {
+        content = INF;
+    }
+
+    bool is_empty() const
+    {
+        return content == INF;
+    }
+
+    bool operator==(const int_holder& holder)
+    {
+        return (content == holder.content);
+    }
+
+    static int hash(const int_holder& holder, int m)
+    {
+        return holder.content % m;
+    }
+
+    /*
+     * Bit k set when slots[k] (k < 16) is live (not INF, not tombstone), for Hashmap iteration.
+     * Slot is 5B, so every 4 slots (20B) are two overlapping 16B loads, pshufb moves contents
+     * and marks to 32-bit lanes, pcmpeqd + movmskps give 4 bits. Reads exactly 80B.
+     */
+    static unsigned live_mask(const int_holder *slots)
+    {
+        const __m128i content_low = _mm_setr_epi8(0, 1, 2, 3, 5, 6, 7, 8, 10, 11, 12, 13, -1, -1, -1, -1);
+        const __m128i content_high = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 11, 12, 13, 14);
+        const __m128i mark_low = _mm_setr_epi8(4, -1, -1, -1, 9, -1, -1, -1, 14, -1, -1, -1, -1, -1, -1, -1);
+        const __m128i mark_high = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 15, -1, -1, -1);
+        const __m128i empty = _mm_set1_epi32(INF);
+        const __m128i zero = _mm_setzero_si128();
+        const char *bytes = reinterpret_cast<const char*>(slots);
+        unsigned result = 0;
+        for (unsigned group = 0; group < 4; group++)
+        {
+            const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 20*group));
+            const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 20*group + 4));
+            const __m128i contents = _mm_or_si128(_mm_shuffle_epi8(low, content_low),
+                                                  _mm_shuffle_epi8(high, content_high));
+            const __m128i marks = _mm_or_si128(_mm_shuffle_epi8(low, mark_low), _mm_shuffle_epi8(high, mark_high));
+            const __m128i live = _mm_andnot_si128(_mm_cmpeq_epi32(contents, empty), _mm_cmpeq_epi32(marks, zero));
+            result |= _mm_movemask_ps(_mm_castsi128_ps(live)) << (4*group);
+        }
+        return result;
+    }
+
+    /*
+     * Bit k set when slots[k] (k < 4*Groups) holds key or is empty (INF), the same loads as live_mask -
+     * for Iter_line, which checks 12 slots of Bucketized_quadratic_hash line at once (60B, 3 groups).
+     */
+    template<unsigned Groups>
+    static unsigned stop_mask(const int_holder *slots, int key)
+    {
+        const __m128i content_low = _mm_setr_epi8(0, 1, 2, 3, 5, 6, 7, 8, 10, 11, 12, 13, -1, -1, -1, -1);
+        const __m128i content_high = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 11, 12, 13, 14);
+        const __m128i empty = _mm_set1_epi32(INF);
+        const __m128i wanted = _mm_set1_epi32(key);
+        const char *bytes = reinterpret_cast<const char*>(slots);
+        unsigned result = 0;
+        for (unsigned group = 0; group < Groups; group++)
+        {
+            const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 20*group));
+            const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 20*group + 4));
+            const __m128i contents = _mm_or_si128(_mm_shuffle_epi8(low, content_low),
+                                                  _mm_shuffle_epi8(high, content_high));
+            const __m128i stop = _mm_or_si128(_mm_cmpeq_epi32(contents, empty), _mm_cmpeq_epi32(contents, wanted));
+            result |= _mm_movemask_ps(_mm_castsi128_ps(stop)) << (4*group);
+        }
+        return result;
+    }
+} __attribute__((packed));
+
+/*
+ * Holders for whole key domain (negative keys, 0xffffffff, 64-bit ids): empty is out of band
+ * (occupied flag next to mark) instead of reserved INF, hash is key taken as unsigned % m
+ * (int_holder's content % m is negative for negative keys). Key holders are built with
+ * occupied = true, only Hashmap makes slots empty.
+ */
+template<class Key>
+struct basic_key_holder final
+{
+    Key content;
+    bool mark;
+    bool occupied {true};
+
+    void init_as_empty()
+    {
+        content = 0;
+        occupied = false;
+    }
+
+    bool is_empty() const
+    {
+        return !occupied;
+    }
+
+    bool operator==(const basic_key_holder& holder)
+    {
+        return (occupied == holder.occupied) && (content == holder.content);
+    }
+
+    static int hash(const basic_key_holder& holder, int m)
+    {
+        return static_cast<std::make_unsigned_t<Key>>(holder.content) % static_cast<unsigned>(m);
+    }
+} __attribute__((packed));
+
+using int64_holder = basic_key_holder<int64_t>;
+using uint64_holder = basic_key_holder<uint64_t>;
+using uint32_holder = basic_key_holder<uint32_t>;
+
+/*
+ * basic_key_holder with inline counter for AggregationHashmap. Equality and hash look at content
+ * only, counter of holder used as lookup key doesn't matter.
+ */
+template<class Key, class Counter>
+struct basic_count_holder final
+{
+    Key content;
+    bool mark;
+    bool occupied {true};
+    Counter counter {0};
+
+    void init_as_empty()
+    {
+        content = 0;
+        occupied = false;
+        counter = 0;
+    }
+
+    bool is_empty() const
+    {
+        return !occupied;
+    }
+
+    bool operator==(const basic_count_holder& holder)
+    {
+        return (occupied == holder.occupied) && (content == holder.content);
+    }
+
+    static int hash(const basic_count_holder& holder, int m)
+    {
+        return static_cast<std::make_unsigned_t<Key>>(holder.content) % static_cast<unsigned>(m);
+    }
+} __attribute__((packed));
+
+using uint32_count_holder = basic_count_holder<uint32_t, uint32_t>;
+using uint64_count_holder = basic_count_holder<uint64_t, uint64_t>;
+
+// basic_key_holder with first build row of key for HashJoin, equality and hash by content only
+template<class Key>
+struct basic_row_holder final
+{
+    Key content;
+    bool mark;
+    bool occupied {true};
+    uint32_t row {0};
+
+    void init_as_empty()
+    {
+        content = 0;
+        occupied = false;
+        row = 0;
+    }
+
+    bool is_empty() const
+    {
+        return !occupied;
+    }
+
+    bool operator==(const basic_row_holder& holder)
+    {
+        return (occupied == holder.occupied) && (content == holder.content);
+    }
+
+    static int hash(const basic_row_holder& holder, int m)
+    {
+        return static_cast<std::make_unsigned_t<Key>>(holder.content) % static_cast<unsigned>(m);
+    }
+} __attribute__((packed));
+
+using uint32_row_holder = basic_row_holder<uint32_t>;
+using uint64_row_holder = basic_row_holder<uint64_t>;
+
+class Linear_hash;
+class Limited_quadratic_hash;
+class Limited_linear_hash;
+class Limited_linear_hash_prime;
+class Double_hash;
+class Bucketized_quadratic_hash;
+
+class Holder_hash;
+
+struct Iter0;
+struct Iter1;
+struct Iter4_Broken_But_Fast;
+
+template<unsigned>
+struct Iter3;
+
+template<unsigned>
+struct Iter3_avx2;
+
+template<unsigned, class>
+struct Iter3_key;
+
+template<unsigned>
+struct Iter_line;
+
+template<unsigned Size,
+         class Holder = int_holder,
+         class Hash = Limited_quadratic_hash,
+         class KeyHash = Holder_hash>
+class Hashmap
+{
+public:
+    using key_type = Holder;
+
+    Hashmap()
+    {
+        claim_storage<Holder>(this, 0);
+        for (auto &e : table)
+        {
+            e.mark = false;
+            e.init_as_empty();
+        }
+    }
+
+    ~Hashmap()
+    {
+        unclaim_storage<Holder>(this, 0);
+    }
+
+    void insert(Holder &c)
+    {
+        const int i = process_search__false(c);
+        if (!(table[i] == c) || table[i].mark)
+        {
+            if (table[i].mark)
+                tombstones_number--;
+            table[i] = std::move(c);
+            table[i].mark = false;
+            n++;
+        }
+    }
+
+    void erase(Holder &c)
+    {
+        const int i = process_search__true(c);
+        if ((table[i] == c) && !table[i].mark)
+        {
+            table[i].mark = true;
+            n--;
+            tombstones_number++;
+        }
+    }
+
+    /*
+     * Bulk erase: every live holder with pred(holder) == true becomes tombstone, like after erase(),
+     * so probe chains stay valid - but there's no probing, slots are scanned in place (live_mask
+     * blocks) in threads disjoint chunks of table, pred is called concurrently. When tombstones
+     * take more than purge_above of capacity afterwards, table is purged. Returns erased number.
+     */
+    template<class Pred>
+    unsigned erase_if(Pred &&pred, unsigned threads = 1, float purge_above = 0.25f)
+    {
+        threads = std::max(1u, threads);
+        std::vector<unsigned> erased(threads, 0);
+        for_each_chunk(threads, [&](unsigned chunk, unsigned first, unsigned last)
+        {
+            unsigned result = 0;
+            for_each(first, last, [&](Holder &holder)
+            {
+                if (pred(holder))
+                {
+                    holder.mark = true;
+                    result++;
+                }
+            });
+            erased[chunk] = result;
+        });
+
+        unsigned result = 0;
+        for (auto number : erased)
+            result += number;
+        n -= result;
+        tombstones_number += result;
+        if (tombstones_number > purge_above*Size)
+            purge();
+        return result;
+    }
+
+    template<class Pred>
+    unsigned retain_if(Pred &&pred, unsigned threads = 1, float purge_above = 0.25f)
+    {
+        return erase_if([&](Holder &holder) { return !pred(holder); }, threads, purge_above);
+    }
+
+    unsigned tombstones() const
+    {
+        return tombstones_number;
+    }
+
+    /*
+     * Drops all tombstones: live holders are moved out, table is emptied (storage of holders is
+     * not released, moved holders still use it) and they are inserted again. Needs n holders
+     * of temporary memory.
+     */
+    void purge()
+    {
+        std::vector<Holder> live;
+        live.reserve(n);
+        for_each([&](Holder &holder) { live.push_back(std::move(holder)); });
+        for (auto &e : table)
+        {
+            e.mark = false;
+            e.init_as_empty();
+        }
+        n = 0;
+        tombstones_number = 0;
+        for (auto &holder : live)
+        {
+            holder.mark = false;
+            insert(holder);
+        }
+    }
+
+    bool member(Holder &c)
+    {
+        int i = process_search__true(c);
+        return (table[i] == c) && !table[i].mark;
+    }
+
+    // collisions are counted in collisions_counter, calls with own counters can run concurrently
+    bool member(Holder &c, unsigned &collisions_counter)
+    {
+        const int i = process_search__true(c, KeyHash::hash(c, table.size()), collisions_counter);
+        return (table[i] == c) && !table[i].mark;
+    }
+
+    bool find(Holder &c) { return member(c); }
+
+    /*
+     * Heterogeneous lookup - key of other type (e.g. std::string_view for sstring holders), no holder
+     * is built so nothing is allocated. Holder::lookup(key) converts key once to whatever is cheap
+     * to compare (e.g. inline word), Holder::hash(lookup, m) has to be equal to hash of holder
+     * with the same content, holder.equals(lookup) compares. Works with Holder_hash key policy only -
+     * int mixers (Murmur_hash, ..) have no hash_key and stop on static_assert in hash_key below.
+     */
+    template<class Key, class H = Holder, class = decltype(H::lookup(std::declval<const Key&>()))>
+    bool member(const Key &key)
+    {
+        const auto lookup = Holder::lookup(key);
+        const int i = process_search_key(lookup);
+        return table[i].equals(lookup) && !table[i].mark;
+    }
+
+    template<class Key, class H = Holder, class = decltype(H::lookup(std::declval<const Key&>()))>
+    bool find(const Key &key) { return member(key); }
+
+    bool member(const char *data, size_t size)
+    {
+        return member(std::string_view(data, size));
+    }
+
+    /*
+     * results[i] = member(keys[i]), in groups of batch_size: hashes of whole group at once (in SIMD when
+     * holder has hash_batch, see Holder_hash) and first slots of group are prefetched while previous
+     * group is probed, so cache misses of group overlap instead of going one after another.
+     */
+    static constexpr unsigned batch_size {16};
+
+    void member_batch(Holder *keys, unsigned keys_number, bool *results)
+    {
+        member_batch(keys, keys_number, results, collisions);
+    }
+
+    // collisions are counted in collisions_counter, member_batch calls with own counters can run concurrently
+    void member_batch(Holder *keys, unsigned keys_number, bool *results, unsigned &collisions_counter)
+    {
+        int hashes[2][batch_size];
+        unsigned group = std::min(batch_size, keys_number);
+        prefetch_batch(keys, group, hashes[0]);
+        for (unsigned first = 0, current = 0; first < keys_number; first += batch_size, current ^= 1)
+        {
+            const unsigned next_first = first + batch_size;
+            const unsigned next_group = (next_first < keys_number)?
+                                        std::min(batch_size, keys_number - next_first) : 0;
+            prefetch_batch(keys + next_first, next_group, hashes[current ^ 1]);
+            for (unsigned k = 0; k < group; k++)
+            {
+                const int i = process_search__true(keys[first + k], hashes[current][k], collisions_counter);
+                results[first + k] = (table[i] == keys[first + k]) && !table[i].mark;
+            }
+            group = next_group;
+        }
+    }
+
+    /*
+     * Iteration over live slots (not empty, not tombstone) in table order. Slots are taken in
+     * blocks of live_block, block is turned into bit mask (Holder::live_mask(slots) when holder has
+     * SIMD one, scalar otherwise) and only set bits are visited - run of 16 empty slots in sparse
+     * table is one mask. Inserts and erases invalidate iterators.
+     */
+    static constexpr unsigned live_block {16};
+
+    class iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Holder;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Holder*;
+        using reference = Holder&;
+
+        // first live slot >= slot
+        iterator(Hashmap *owner, unsigned slot) : hashmap(owner)
+        {
+            seek(slot);
+        }
+
+        Holder& operator*() const { return hashmap->table[i]; }
+        Holder* operator->() const { return &hashmap->table[i]; }
+
+        iterator& operator++()
+        {
+            mask &= mask - 1;
+            if (mask)
+                i = i - i%live_block + __builtin_ctz(mask);
+            else
+                seek(i - i%live_block + live_block);
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            iterator result = *this;
+            ++*this;
+            return result;
+        }
+
+        bool operator==(const iterator &another) const { return i == another.i; }
+        bool operator!=(const iterator &another) const { return i != another.i; }
+
+    private:
+        void seek(unsigned slot)
+        {
+            unsigned block = slot - slot%live_block;
+            mask = (block < Size)? hashmap->block_mask(block) & (~0u << (slot - block)) : 0;
+            while (!mask && ((block += live_block) < Size))
+                mask = hashmap->block_mask(block);
+            i = mask? block + __builtin_ctz(mask) : Size;
+        }
+
+        Hashmap *hashmap;
+        unsigned i;
+        unsigned mask; // live slots of current block from i on
+    };
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, Size); }
+
+    // fn(holder) for every live slot, cheaper than iterator (no search for next one between calls)
+    template<class Fn>
+    void for_each(Fn &&fn)
+    {
+        for_each(0, Size, std::forward<Fn>(fn));
+    }
+
+    /*
+     * Set algebra, result gets copies of holders (so Holder has to be copyable - int_holder, key
+     * holders) of this and other (same Holder, any Size), result can't be one of them. Holders of one
+     * table are probed in the other in place (probe_each), threads split probing table in chunks,
+     * inserts to result are done afterwards in this thread.
+     * intersect probes with smaller table, unite copies larger one and probes with smaller.
+     */
+    template<class Other, class Result>
+    void intersect(Other &other, Result &result, unsigned threads = 1)
+    {
+        if (other.size() < size())
+            other.intersect(*this, result, threads);
+        else
+            insert_probed(other, result, true, threads);
+    }
+
+    template<class Other, class Result>
+    void unite(Other &other, Result &result, unsigned threads = 1)
+    {
+        if (other.size() > size())
+        {
+            other.unite(*this, result, threads);
+            return;
+        }
+        for_each([&](Holder &holder)
+        {
+            Holder copy(holder);
+            result.insert(copy);
+        });
+        other.difference(*this, result, threads);
+    }
+
+    // this \ other
+    template<class Other, class Result>
+    void difference(Other &other, Result &result, unsigned threads = 1)
+    {
+        insert_probed(other, result, false, threads);
+    }
+
+    /*
+     * fn(chunk, holder, member) for every live holder of this table, member - whether other has it.
+     * Slot is probed in other in place, one member call per holder (no gathering, see iteration 11).
+     * Table is split in threads chunks, fn of different chunks is called concurrently. Other can't
+     * change meanwhile, its collisions are counted per thread and added up at the end.
+     */
+    template<class Other, class Fn>
+    void probe_each(Other &other, Fn &&fn, unsigned threads = 1)
+    {
+        threads = std::max(1u, threads);
+        std::vector<unsigned> other_collisions(threads, 0);
+        for_each_chunk(threads, [&](unsigned chunk, unsigned first, unsigned last)
+        {
+            unsigned counter = 0;
+            for_each(first, last, [&](Holder &holder)
+            {
+                fn(chunk, holder, other.member(holder, counter));
+            });
+            other_collisions[chunk] = counter;
+        });
+        for (auto number : other_collisions)
+            other.collisions += number;
+    }
+
+    unsigned size() const
+    {
+        return n;
+    }
+
+    unsigned capacity() const
+    {
+        return table.size();
+    }
+
+    unsigned bucket_count() const
+    {
+        return capacity();
+    }
+
+    // holders with own storage (e.g. arena of sstring) give it back at once, after all slots are empty
+    void reset()
+    {
+        n = 0;
+        tombstones_number = 0;
+        collisions = 0;
+        for (auto &e : table)
+        {
+            e.mark = false;
+            e.init_as_empty();
+        }
+        release_storage<Holder>(0);
+    }
+
+    void clear() { reset(); }
+
+    unsigned collisions {0};
+
+protected:
+
+    template<class Fn>
+    void for_each(unsigned first, unsigned last, Fn &&fn)
+    {
+        for (unsigned block = first; block < last; block += live_block)
+            for (unsigned mask = block_mask(block); mask; mask &= mask - 1)
+                fn(table[block + __builtin_ctz(mask)]);
+    }
+
+    // fn(chunk, first, last) for threads chunks of slots (block aligned), chunk 0 in this thread
+    template<class Fn>
+    void for_each_chunk(unsigned threads, Fn &&fn)
+    {
+        const unsigned blocks = (Size + live_block - 1)/live_block;
+        const unsigned chunk_blocks = (blocks + threads - 1)/threads;
+        auto run = [&](unsigned chunk)
+        {
+            fn(chunk, std::min(blocks, chunk*chunk_blocks)*live_block,
+               std::min(blocks, (chunk + 1)*chunk_blocks)*live_block);
+        };
+        std::vector<std::thread> workers;
+        for (unsigned chunk = 1; chunk < threads; chunk++)
+            workers.emplace_back(run, chunk);
+        run(0);
+        for (auto &worker : workers)
+            worker.join();
+    }
+
+    // result gets copies of holders which are (want_members) or aren't members of other
+    template<class Other, class Result>
+    void insert_probed(Other &other, Result &result, bool want_members, unsigned threads)
+    {
+        // own cache line per chunk, push_back of neighbours doesn't bounce it
+        struct alignas(64) chosen_holders
+        {
+            std::vector<Holder*> holders;
+        };
+        threads = std::max(1u, threads);
+        if (threads == 1)
+        {
+            probe_each(other, [&](unsigned, Holder &holder, bool member)
+            {
+                if (member == want_members)
+                {
+                    Holder copy(holder);
+                    result.insert(copy);
+                }
+            });
+            return;
+        }
+        std::vector<chosen_holders> chosen(threads);
+        probe_each(other, [&](unsigned chunk, Holder &holder, bool member)
+        {
+            if (member == want_members)
+                chosen[chunk].holders.push_back(&holder);
+        }, threads);
+        for (auto &chunk : chosen)
+            for (Holder *holder : chunk.holders)
+            {
+                Holder copy(*holder);
+                result.insert(copy);
+            }
+    }
+
+    template<class H>
+    static auto release_storage(int) -> decltype(H::release_storage(), void())
+    {
+        H::release_storage();
+    }
+
+    template<class H>
+    static void release_storage(long) {}
+
+    // holders with shared storage (arena) let only one table use it
+    template<class H>
+    static auto claim_storage(const void *owner, int) -> decltype(H::claim_storage(owner), void())
+    {
+        H::claim_storage(owner);
+    }
+
+    template<class H>
+    static void claim_storage(const void *, long) {}
+
+    template<class H>
+    static auto unclaim_storage(const void *owner, int) -> decltype(H::unclaim_storage(owner), void())
+    {
+        H::unclaim_storage(owner);
+    }
+
+    template<class H>
+    static void unclaim_storage(const void *, long) {}
+
+    // holder of plain key (key holders, content + mark)
+    template<class Key>
+    static Holder make_holder(const Key &key)
+    {
+        Holder c {};
+        c.content = key;
+        c.mark = false;
+        return c;
+    }
+
+    // holders and hashes of plain keys, their first slots are prefetched - next group of pipelined batch
+    template<class Key>
+    void prepare_batch(const Key *keys, unsigned keys_number, Holder *holders, int *hashes, bool for_write)
+    {
+        const int m = table.size();
+        for (unsigned k = 0; k < keys_number; k++)
+        {
+            holders[k] = make_holder(keys[k]);
+            hashes[k] = KeyHash::hash(holders[k], m);
+            if (for_write)
+                __builtin_prefetch(&table[Hash::h(hashes[k], 0, m)], 1);
+            else
+                __builtin_prefetch(&table[Hash::h(hashes[k], 0, m)]);
+        }
+    }
+
+    void prefetch_batch(Holder *keys, unsigned keys_number, int *hashes)
+    {
+        const int m = table.size();
+        hash_batch<KeyHash>(keys, keys_number, m, hashes, 0);
+        for (unsigned k = 0; k < keys_number; k++)
+            __builtin_prefetch(&table[Hash::h(hashes[k], 0, m)]);
+    }
+
+    template<class H>
+    static auto live_mask(const Holder *slots, int) -> decltype(H::live_mask(slots))
+    {
+        return H::live_mask(slots);
+    }
+
+    template<class H>
+    static unsigned live_mask(const Holder *slots, long)
+    {
+        unsigned result = 0;
+        for (unsigned k = 0; k < live_block; k++)
+            result |= static_cast<unsigned>(!const_cast<Holder&>(slots[k]).is_empty() && !slots[k].mark) << k;
+        return result;
+    }
+
+    // bit k - slot block + k is live, last block can be shorter than live_block
+    unsigned block_mask(unsigned block)
+    {
+        if (block + live_block <= Size)
+            return live_mask<Holder>(&table[block], 0);
+        unsigned result = 0;
+        for (unsigned k = 0; block + k < Size; k++)
+            result |= static_cast<unsigned>(!table[block + k].is_empty() && !table[block + k].mark) << k;
+        return result;
+    }
+
+    template<class K>
+    static auto hash_batch(Holder *keys, unsigned n, int m, int *hashes, int)
+        -> decltype(K::template hash_batch<Holder>(keys, n, m, hashes), void())
+    {
+        K::template hash_batch<Holder>(keys, n, m, hashes);
+    }
+
+    template<class K>
+    static void hash_batch(Holder *keys, unsigned n, int m, int *hashes, long)
+    {
+        for (unsigned k = 0; k < n; k++)
+            hashes[k] = K::hash(keys[k], m);
+    }
+
+    template<class K, class Key>
+    static auto hash_key(const Key &key, int m, int) -> decltype(K::template hash_key<Holder>(key, m))
+    {
+        return K::template hash_key<Holder>(key, m);
+    }
+
+    template<class K, class Key>
+    static int hash_key(const Key &, int, long)
+    {
+        static_assert(sizeof(K) == 0, "heterogeneous member needs KeyHash with hash_key (Holder_hash)");
+        return 0;
+    }
+
+    template<class Key>
+    int process_search_key(const Key &key)
+    {
+        const int m = table.size();
+        const int hash_holder = hash_key<KeyHash>(key, m, 0);
+        int j = 0;
+        int i = Hash::h(hash_holder, j, m);
+
+        while (!table[i].equals(key) && (!table[i].is_empty()))
+        {
+            j++;
+            i = Hash::h(hash_holder, j, m);
+            collisions++;
+        }
+        return i;
+    }
+
+    int process_search__true(Holder &c)
+    {
+        return process_search__true(c, KeyHash::hash(c, table.size()));
+    }
+
+    int process_search__true(Holder &c, int hash_holder)
+    {
+        return process_search__true(c, hash_holder, collisions);
+    }
+
+    int process_search__true(Holder &c, int hash_holder, unsigned &collisions_counter)
+    {
+        const int m = table.size();
+        int j = 0;
+        int i = Hash::h(hash_holder, j, m);
+
+        while ( !(table[i] == c) && (!table[i].is_empty()))
+        {
+            j++;
+            i = Hash::h(hash_holder, j, m);
+            collisions_counter++;
+        }
+        return i;
+    }
+
+    /*
+     * Erased slots keep their content with mark = true (tombstone) so probe chains stay intact.
+     * Insert always lands on the first tombstone or empty slot of the chain, so the first slot
+     * holding c is the only one which may be live. Search stops on it, insert reuses
+     * the first tombstone seen on the way.
+     */
+    int process_search__false(Holder &c)
+    {
+        return process_search__false(c, KeyHash::hash(c, table.size()));
+    }
+
+    int process_search__false(Holder &c, int hash_holder)
+    {
+        const int m = table.size();
+        int j = 0;
+        int i = Hash::h(hash_holder, j, m);
+        int tombstone = -1;
+
+        while ( !(table[i] == c) && (!table[i].is_empty()))
+        {
+            if (table[i].mark && (tombstone < 0))
+                tombstone = i;
+            j++;
+            i = Hash::h(hash_holder, j, m);
+            collisions++;
+        }
+        if ((table[i] == c) && !table[i].mark)
+            return i;
+        return (tombstone < 0)? i : tombstone;
+    }
+
+    unsigned n {0};
+    unsigned tombstones_number {0};
+public:
+    static_assert((Size == 50000021) || (Size == 10000019) || (Size == 4000037) || (Size == 2000003) || (Size == 200003)
+                  || (Size == 100003) || (Size == 500), "Size not supported");
+    std::array<Holder, Size> table;
+};
+
+// TSC read which can't be moved before preceding loads (lfence), for timing runs of calls
+static inline uint64_t ticks_now()
+{
+    _mm_lfence();
+    return __rdtsc();
+}
+
+static inline bool has_avx2()
+{
+    static const bool result = __builtin_cpu_supports("avx2");
+    return result;
+}
+
+enum class probe_kernel : unsigned
+{
+    scalar,     // process_search__true
+    sse,        // Iter3
+    avx2        // Iter3_avx2
+};
+
+constexpr unsigned probe_kernels {3};
+
+static inline const char* kernel_name(probe_kernel kernel)
+{
+    static const char *names[probe_kernels] {"scalar", "sse", "avx2"};
+    return names[static_cast<unsigned>(kernel)];
+}
+
+// what adaptive_member of ExperimentalHashmap did so far, cycles are TSC ticks of sample runs
+struct kernel_counters final
+{
+    probe_kernel active {probe_kernel::scalar};
+    uint64_t calls[probe_kernels] {};
+    uint64_t samples[probe_kernels] {};     // calls in sample runs
+    uint64_t cycles[probe_kernels] {};
+    uint64_t scalar_probes {0};             // slots visited in scalar sample runs
+    unsigned epochs {0};
+    unsigned switches {0};
+    bool settled {false};                   // sampling stopped, table is stable
+};
+
+/*
+ * adaptive_member picks kernel for the table online instead of fast_member's n > 0.8*m rule:
+ * - epoch is one run of active kernel (epoch_calls, doubled after every quiet epoch up to 16x) and
+ *   sample_runs runs of sample_run calls of every available kernel in turn (avx2 only when CPU
+ *   has it). Fast path is countdown and switch on kernel of current run, only run boundaries
+ *   read TSC (ticks_now). Runs are timed as a whole - timing single calls serializes them and
+ *   puts away just what SIMD kernels win on (overlapped loads, no mispredicted loop exit).
+ * - end of epoch: ticks per call go into moving average (1/4 of new epoch), kernel is switched
+ *   when another one is cheaper by more than 1/8 in two epochs in a row (hysteresis). First
+ *   epoch picks the cheapest one.
+ * - after stable_epochs quiet epochs at full backoff sampling stops (settled): only runs of active
+ *   kernel, until n moves by more than Size/16 from where it settled - then epochs start again.
+ * Quadratic probing only - Iter3 kernels probe hc + j + j^2.
+ */
+template<unsigned Size, class Hash = Limited_quadratic_hash, class KeyHash = Holder_hash>
+class ExperimentalHashmap final : public Hashmap<Size, int_holder, Hash, KeyHash>
+{
+public:
+    using Hashmap<Size, int_holder, Hash, KeyHash>::n;
+    using Hashmap<Size, int_holder, Hash, KeyHash>::table;
+    using Hashmap<Size, int_holder, Hash, KeyHash>::collisions;
+    using Hashmap<Size, int_holder, Hash, KeyHash>::process_search__true;
+
+    static constexpr unsigned epoch_calls {1u << 15};
+    static constexpr unsigned max_backoff {4};
+    static constexpr unsigned sample_run {64};
+    static constexpr unsigned sample_runs {2};
+    static constexpr unsigned stable_epochs {4};
+
+    template<
+            template<unsigned> class Func = Iter3
+            >
+    bool fast_member(int_holder &c)
+    {
+        int i = 0;
+        if (n > (4*table.size()/5))
+        {
+            i = Func<Size>::process_search__true__optimized(table, c, KeyHash::hash(c, table.size()));
+        }
+        else
+        {
+            i = process_search__true(c);
+        }
+        return (table[i] == c) && !table[i].mark;
+    }
+
+    bool adaptive_member(int_holder &c)
+    {
+        if (__builtin_expect(--countdown == 0, 0))
+            next_run();
+        const int i = probe(current, c);
+        return (table[i] == c) && !table[i].mark;
+    }
+
+    int probe(probe_kernel kernel, int_holder &c)
+    {
+        static_assert(std::is_same<Hash, Limited_quadratic_hash>::value, "Iter3 kernels probe quadratically");
+        switch (kernel)
+        {
+        case probe_kernel::sse:
+            return Iter3<Size>::process_search__true__optimized(table, c, KeyHash::hash(c, table.size()));
+        case probe_kernel::avx2:
+            return Iter3_avx2<Size>::process_search__true__optimized(table, c, KeyHash::hash(c, table.size()));
+        default:
+            return process_search__true(c);
+        }
+    }
+
+    // calls of current run included
+    kernel_counters adaptive_counters() const
+    {
+        kernel_counters result = counters;
+        result.calls[static_cast<unsigned>(current)] += run_length - countdown + 1;
+        return result;
+    }
+
+private:
+    // closes current run, starts the next one - next call is its first
+    __attribute__((noinline)) void next_run()
+    {
+        const uint64_t now = ticks_now();
+        const unsigned kernel = static_cast<unsigned>(current);
+        counters.calls[kernel] += run_length;
+        if (sampling)
+        {
+            counters.samples[kernel] += run_length;
+            counters.cycles[kernel] += now - run_start;
+            epoch_ticks[kernel] += now - run_start;
+            epoch_samples[kernel] += run_length;
+            if (current == probe_kernel::scalar)
+                counters.scalar_probes += collisions - collisions_start + run_length;
+        }
+
+        const unsigned kernels = has_avx2()? probe_kernels : probe_kernels - 1;
+        if (counters.settled && (std::max(n, settled_n) - std::min(n, settled_n) > Size/16))
+        {
+            counters.settled = false;
+            quiet = 0;
+            backoff = 0;
+        }
+        if (!counters.settled && (sampled < sample_runs*kernels))
+        {
+            current = static_cast<probe_kernel>(sampled%kernels);
+            sampling = true;
+            sampled++;
+            run_length = sample_run;
+        }
+        else
+        {
+            if (!counters.settled)
+            {
+                choose(kernels);
+                sampled = 0;
+                counters.settled = (quiet >= stable_epochs);
+                settled_n = n;
+            }
+            current = counters.active;
+            sampling = false;
+            run_length = epoch_calls << backoff;
+        }
+        countdown = run_length;
+        collisions_start = collisions;
+        run_start = ticks_now();
+    }
+
+    void choose(unsigned kernels)
+    {
+        unsigned best = 0;
+        for (unsigned k = 0; k < kernels; k++)
+        {
+            const double mean = epoch_ticks[k]*1.0/epoch_samples[k];
+            cost[k] = (counters.epochs == 0)? mean : 0.75*cost[k] + 0.25*mean;
+            epoch_ticks[k] = 0;
+            epoch_samples[k] = 0;
+            if (cost[k] < cost[best])
+                best = k;
+        }
+        const unsigned active = static_cast<unsigned>(counters.active);
+        if ((best != active) && (8*cost[best] < 7*cost[active]))
+            streak = (best == candidate)? streak + 1 : 1;
+        else
+            streak = 0;
+        candidate = best;
+        if ((best != active) && ((counters.epochs == 0) || (streak >= 2)))
+        {
+            counters.active = static_cast<probe_kernel>(best);
+            counters.switches++;
+            streak = 0;
+        }
+        backoff = (streak == 0 && counters.epochs > 0)? std::min(backoff + 1, max_backoff) : 0;
+        quiet = (streak == 0 && backoff == max_backoff)? quiet + 1 : 0;
+        counters.epochs++;
+    }
+
+    kernel_counters counters;
+    double cost[probe_kernels] {};
+    uint64_t epoch_ticks[probe_kernels] {};
+    uint64_t epoch_samples[probe_kernels] {};
+    unsigned candidate {0};
+    unsigned streak {0};
+    unsigned backoff {0};
+    unsigned quiet {0};
+    unsigned settled_n {0};
+    unsigned sampled {0};
+    probe_kernel current {probe_kernel::scalar};
+    bool sampling {false};
+    uint64_t run_start {0};
+    unsigned collisions_start {0};
+    // first call starts sampling
+    unsigned countdown {1};
+    unsigned run_length {0};
+};
+
+// fast_member of ExperimentalHashmap for basic_key_holder (Iter3_key instead of Iter3)
+template<unsigned Size, class Holder, class Hash = Limited_quadratic_hash, class KeyHash = Holder_hash>
+class ExperimentalKeyHashmap final : public Hashmap<Size, Holder, Hash, KeyHash>
+{
+public:
+    using Hashmap<Size, Holder, Hash, KeyHash>::n;
+    using Hashmap<Size, Holder, Hash, KeyHash>::table;
+    using Hashmap<Size, Holder, Hash, KeyHash>::process_search__true;
+
+    template<
+            template<unsigned, class> class Func = Iter3_key
+            >
+    bool fast_member(Holder &c)
+    {
+        int i = 0;
+        if (n > (4*table.size()/5))
+        {
+            i = Func<Size, Holder>::process_search__true__optimized(table, c, KeyHash::hash(c, table.size()));
+        }
+        else
+        {
+            i = process_search__true(c);
+        }
+        return (table[i] == c) && !table[i].mark;
+    }
+};
+
+/*
+ * Counting / group-by table: holder keeps counter next to key (basic_count_holder), upsert finds
+ * slot of key or slot for it in one probe sequence (member + insert would take two).
+ * aggregate(keys) is upsert(key, 1) for many keys: keys are taken in groups of batch_size, hashes
+ * of next group are computed and its first slots prefetched while current group is upserted (like
+ * member_batch). Threads count into own tables, merge adds one table to another.
+ */
+template<unsigned Size, class Holder = uint32_count_holder, class Hash = Limited_quadratic_hash,
+         class KeyHash = Holder_hash>
+class AggregationHashmap final : public Hashmap<Size, Holder, Hash, KeyHash>
+{
+public:
+    using base = Hashmap<Size, Holder, Hash, KeyHash>;
+    using base::n;
+    using base::tombstones_number;
+    using base::table;
+    using base::batch_size;
+    using content_type = decltype(Holder::content);
+    using counter_type = decltype(Holder::counter);
+
+    // counter of key after adding delta
+    counter_type upsert(content_type key, counter_type delta = 1)
+    {
+        Holder c = base::make_holder(key);
+        return upsert(c, KeyHash::hash(c, table.size()), delta);
+    }
+
+    // 0 for missing key
+    counter_type count(content_type key)
+    {
+        Holder c = base::make_holder(key);
+        const int i = base::process_search__true(c);
+        return ((table[i] == c) && !table[i].mark)? table[i].counter : 0;
+    }
+
+    void aggregate(const content_type *keys, unsigned keys_number)
+    {
+        Holder holders[2][batch_size];
+        int hashes[2][batch_size];
+        unsigned group = std::min(batch_size, keys_number);
+        base::prepare_batch(keys, group, holders[0], hashes[0], true);
+        for (unsigned first = 0, current = 0; first < keys_number; first += batch_size, current ^= 1)
+        {
+            const unsigned next_first = first + batch_size;
+            const unsigned next_group = (next_first < keys_number)?
+                                        std::min(batch_size, keys_number - next_first) : 0;
+            base::prepare_batch(keys + next_first, next_group, holders[current ^ 1], hashes[current ^ 1], true);
+            for (unsigned k = 0; k < group; k++)
+                upsert(holders[current][k], hashes[current][k], 1);
+            group = next_group;
+        }
+    }
+
+    // counters of other are added to this, e.g. per thread tables at the end
+    template<class Other>
+    void merge(Other &other)
+    {
+        other.for_each([&](Holder &holder)
+        {
+            Holder c = base::make_holder(holder.content);
+            upsert(c, KeyHash::hash(c, table.size()), holder.counter);
+        });
+    }
+
+private:
+    counter_type upsert(Holder &c, int hash_holder, counter_type delta)
+    {
+        const int i = base::process_search__false(c, hash_holder);
+        if ((table[i] == c) && !table[i].mark)
+            return table[i].counter += delta;
+        if (table[i].mark)
+            tombstones_number--;
+        table[i] = c;
+        table[i].mark = false;
+        table[i].counter = delta;
+        n++;
+        return delta;
+    }
+};
+
+/*
+ * Hash join of two key columns, build side has to fit in table (distinct keys), rows are indexes
+ * into columns. Slot keeps first build row of key (basic_row_holder), other rows of the same key
+ * are chained in next (row -> next row, no_row ends), so duplicates cost no slots.
+ * probe streams probe column in groups of batch_size (hashes + prefetch of next group, like
+ * AggregationHashmap::aggregate) and writes (build row, probe row) of every match to out. With
+ * threads probe column is split in chunks, matches are gathered per thread and copied to out in
+ * blocks, place is taken by one atomic add - order of matches in out is not defined then.
+ * probe returns number of all matches, only first out_capacity of them are written.
  */
+struct join_match
+{
+    uint32_t build_row;
+    uint32_t probe_row;
+};
+
+template<unsigned Size, class Holder = uint32_row_holder, class Hash = Limited_quadratic_hash,
+         class KeyHash = Holder_hash>
+class HashJoin final : public Hashmap<Size, Holder, Hash, KeyHash>
+{
+public:
+    using base = Hashmap<Size, Holder, Hash, KeyHash>;
+    using base::n;
+    using base::tombstones_number;
+    using base::table;
+    using base::batch_size;
+    using base::collisions;
+    using content_type = decltype(Holder::content);
+
+    static constexpr uint32_t no_row {~0u};
+    static constexpr unsigned flush_size {1024};
+
+    // previous build is dropped
+    void build(const content_type *keys, uint32_t rows_number)
+    {
+        base::reset();
+        next.assign(rows_number, no_row);
+        Holder holders[2][batch_size];
+        int hashes[2][batch_size];
+        unsigned group = std::min<uint32_t>(batch_size, rows_number);
+        base::prepare_batch(keys, group, holders[0], hashes[0], true);
+        for (uint32_t first = 0, current = 0; first < rows_number; first += batch_size, current ^= 1)
+        {
+            const uint32_t next_first = first + batch_size;
+            const unsigned next_group = (next_first < rows_number)?
+                                        std::min<uint32_t>(batch_size, rows_number - next_first) : 0;
+            base::prepare_batch(keys + next_first, next_group, holders[current ^ 1], hashes[current ^ 1], true);
+            for (unsigned k = 0; k < group; k++)
+                add_row(holders[current][k], hashes[current][k], first + k);
+            group = next_group;
+        }
+    }
+
+    size_t probe(const content_type *keys, uint32_t rows_number, join_match *out, size_t out_capacity,
+                 unsigned threads = 1)
+    {
+        threads = std::max(1u, threads);
+        std::atomic<size_t> matches {0};
+        std::vector<unsigned> thread_collisions(threads, 0);
+        const uint32_t chunk = (rows_number + threads - 1)/threads;
+        auto run = [&](unsigned thread)
+        {
+            const uint32_t first = std::min<uint64_t>(rows_number, uint64_t(thread)*chunk);
+            const uint32_t last = std::min<uint64_t>(rows_number, uint64_t(first) + chunk);
+            thread_collisions[thread] = probe_rows(keys, first, last, out, out_capacity, matches);
+        };
+        std::vector<std::thread> workers;
+        for (unsigned thread = 1; thread < threads; thread++)
+            workers.emplace_back(run, thread);
+        run(0);
+        for (auto &worker : workers)
+            worker.join();
+        for (auto number : thread_collisions)
+            collisions += number;
+        return matches.load();
+    }
+
+    uint32_t build_rows() const
+    {
+        return next.size();
+    }
+
+private:
+    void add_row(Holder &c, int hash_holder, uint32_t row)
+    {
+        const int i = base::process_search__false(c, hash_holder);
+        if ((table[i] == c) && !table[i].mark)
+        {
+            next[row] = table[i].row;
+            table[i].row = row;
+            return;
+        }
+        if (table[i].mark)
+            tombstones_number--;
+        table[i] = c;
+        table[i].mark = false;
+        table[i].row = row;
+        n++;
+    }
 
-namespace common
-{
+    // rows [first, last), returns collisions
+    unsigned probe_rows(const content_type *keys, uint32_t first_row, uint32_t last_row, join_match *out,
+                        size_t out_capacity, std::atomic<size_t> &matches)
+    {
+        join_match local[flush_size];
+        unsigned local_number = 0, counter = 0;
+        auto flush = [&]()
+        {
+            const size_t place = matches.fetch_add(local_number, std::memory_order_relaxed);
+            if (place < out_capacity)
+                std::copy(local, local + std::min<size_t>(local_number, out_capacity - place), out + place);
+            local_number = 0;
+        };
+
+        const uint32_t rows_number = last_row - first_row;
+        keys += first_row;
+        Holder holders[2][batch_size];
+        int hashes[2][batch_size];
+        unsigned group = std::min<uint32_t>(batch_size, rows_number);
+        base::prepare_batch(keys, group, holders[0], hashes[0], false);
+        for (uint32_t first = 0, current = 0; first < rows_number; first += batch_size, current ^= 1)
+        {
+            const uint32_t next_first = first + batch_size;
+            const unsigned next_group = (next_first < rows_number)?
+                                        std::min<uint32_t>(batch_size, rows_number - next_first) : 0;
+            base::prepare_batch(keys + next_first, next_group, holders[current ^ 1], hashes[current ^ 1], false);
+            for (unsigned k = 0; k < group; k++)
+            {
+                Holder &c = holders[current][k];
+                const int i = base::process_search__true(c, hashes[current][k], counter);
+                if (!(table[i] == c) || table[i].mark)
+                    continue;
+                for (uint32_t row = table[i].row; row != no_row; row = next[row])
+                {
+                    if (local_number == flush_size)
+                        flush();
+                    local[local_number++] = {row, first_row + first + k};
+                }
+            }
+            group = next_group;
+        }
+        flush();
+        return counter;
+    }
 
-constexpr int INF {-1};
+    std::vector<uint32_t> next;
+};
 
-struct int_holder final
+/*
+ * Radix partitioned set: 2^RadixBits independent Hashmap<PartitionSize> (e.g. 512 x 100003 int_holder
+ * slots, 500KB each - fits L2). Partition of key is given by high bits of multiplicative hash of
+ * holder hash, so partition and slot inside it don't depend on each other.
+ * - insert_bulk(keys) scatters keys to partitions first: histogram, then one pass through write
+ *   combining buffers (cache line of keys per partition, copied out when full, so scatter keeps
+ *   2^RadixBits lines hot instead of writing to random places), then partitions are filled one
+ *   by one from contiguous runs - inserts hit table in L2 instead of DRAM.
+ * - member_bulk(keys, results) the same way, keys are scattered with their indexes.
+ * - single key insert/member/erase go to its partition directly.
+ * Partitions don't grow, insert_bulk throws std::length_error (and inserts nothing) when any
+ * partition would be filled over max_partition_load.
+ */
+template<unsigned RadixBits, unsigned PartitionSize, class Holder = int_holder,
+         class Hash = Limited_quadratic_hash, class KeyHash = Holder_hash>
+class PartitionedHashmap final
 {
-    int content;
-    bool mark;
+public:
+    using table_type = Hashmap<PartitionSize, Holder, Hash, KeyHash>;
+    using content_type = decltype(Holder::content);
 
-    void init_as_empty()
+    static constexpr unsigned partitions_number {1u << RadixBits};
+    static constexpr float max_partition_load {0.9f};
+
+    static_assert((RadixBits > 0) && (RadixBits < 16), "RadixBits not supported");
+
+    PartitionedHashmap()
     {
-        content = INF;
+        for (auto &partition : partitions)
+            partition.reset(new table_type());
     }
 
-    bool is_empty() const
+    static unsigned partition_of(Holder &c)
     {
-        return content == INF;
+        const uint32_t hash = KeyHash::hash(c, std::numeric_limits<int>::max());
+        return (hash*2654435761u) >> (32 - RadixBits);
     }
 
-    bool operator==(const int_holder& holder)
+    void insert(Holder &c) { partitions[partition_of(c)]->insert(c); }
+    void erase(Holder &c) { partitions[partition_of(c)]->erase(c); }
+    bool member(Holder &c) { return partitions[partition_of(c)]->member(c); }
+
+    void insert_bulk(const content_type *keys, size_t keys_number)
     {
-        return (content == holder.content);
+        std::unique_ptr<content_type[]> scattered;
+        std::vector<size_t> offsets;
+        scatter(keys_number, [keys](size_t k) { return keys[k]; }, scattered, offsets,
+                [](const content_type &key)
+        {
+            Holder c = holder_of(key);
+            return partition_of(c);
+        });
+        for (unsigned partition = 0; partition < partitions_number; partition++)
+            if (partitions[partition]->size() + (offsets[partition + 1] - offsets[partition])
+                > max_partition_load*PartitionSize)
+                throw std::length_error("partition is full");
+
+        for (unsigned partition = 0; partition < partitions_number; partition++)
+        {
+            table_type &table = *partitions[partition];
+            for (size_t k = offsets[partition]; k < offsets[partition + 1]; k++)
+            {
+                Holder c = holder_of(scattered[k]);
+                table.insert(c);
+            }
+        }
     }
 
-    static int hash(const int_holder& holder, int m)
+    void member_bulk(const content_type *keys, size_t keys_number, bool *results)
     {
-        return holder.content % m;
+        struct indexed_key
+        {
+            content_type key;
+            uint32_t index;
+        };
+        std::unique_ptr<indexed_key[]> scattered;
+        std::vector<size_t> offsets;
+        scatter(keys_number, [keys](size_t k) { return indexed_key {keys[k], static_cast<uint32_t>(k)}; },
+                scattered, offsets, [](const indexed_key &item)
+        {
+            Holder c = holder_of(item.key);
+            return partition_of(c);
+        });
+
+        for (unsigned partition = 0; partition < partitions_number; partition++)
+        {
+            table_type &table = *partitions[partition];
+            for (size_t k = offsets[partition]; k < offsets[partition + 1]; k++)
+            {
+                Holder c = holder_of(scattered[k].key);
+                results[scattered[k].index] = table.member(c);
+            }
+        }
     }
-} __attribute__((packed));
 
-class Linear_hash;
-class Limited_quadratic_hash;
-class Limited_linear_hash;
-class Limited_linear_hash_prime;
-class Double_hash;
+    template<class Fn>
+    void for_each(Fn &&fn)
+    {
+        for (auto &partition : partitions)
+            partition->for_each(fn);
+    }
 
-struct Iter0;
-struct Iter1;
-struct Iter4_Broken_But_Fast;
+    unsigned size() const
+    {
+        unsigned result = 0;
+        for (auto &partition : partitions)
+            result += partition->size();
+        return result;
+    }
 
-template<unsigned>
-struct Iter3;
+    unsigned capacity() const
+    {
+        return partitions_number*PartitionSize;
+    }
 
-template<unsigned Size,
-         class Holder = int_holder,
-         class Hash = Limited_quadratic_hash>
-class Hashmap
-{
-public:
-    using key_type = Holder;
+    void reset()
+    {
+        for (auto &partition : partitions)
+            partition->reset();
+    }
 
-    Hashmap()
+private:
+    static Holder holder_of(const content_type &key)
     {
-        for (auto &e : table)
+        Holder c {};
+        c.content = key;
+        c.mark = false;
+        return c;
+    }
+
+    /*
+     * Items item_at(0 .. items_number) of partition p are in scattered[offsets[p], offsets[p + 1])
+     * afterwards, in input order. Every partition has buffer of one cache line in buffers (aligned,
+     * so buffer never straddles two lines), full one is copied to its place at once.
+     */
+    template<class ItemAt, class Item, class PartitionOf>
+    static void scatter(size_t items_number, ItemAt &&item_at, std::unique_ptr<Item[]> &scattered,
+                        std::vector<size_t> &offsets, PartitionOf &&partition_of_item)
+    {
+        constexpr unsigned buffer_items = std::max<unsigned>(1, 64/sizeof(Item));
+        struct alignas(64) line
         {
-            e.mark = false;
-            e.init_as_empty();
+            Item items[buffer_items];
+        };
+        offsets.assign(partitions_number + 1, 0);
+        for (size_t k = 0; k < items_number; k++)
+            offsets[partition_of_item(item_at(k)) + 1]++;
+        for (unsigned partition = 0; partition < partitions_number; partition++)
+            offsets[partition + 1] += offsets[partition];
+        // not value initialized, every item is written once
+        scattered.reset(new Item[items_number]);
+
+        std::vector<size_t> cursors(offsets.begin(), offsets.end() - 1);
+        std::vector<line> buffers(partitions_number);
+        std::vector<unsigned> filled(partitions_number, 0);
+        for (size_t k = 0; k < items_number; k++)
+        {
+            const Item item = item_at(k);
+            const unsigned partition = partition_of_item(item);
+            Item *buffer = buffers[partition].items;
+            buffer[filled[partition]++] = item;
+            if (filled[partition] == buffer_items)
+            {
+                std::copy(buffer, buffer + buffer_items, &scattered[cursors[partition]]);
+                cursors[partition] += buffer_items;
+                filled[partition] = 0;
+            }
         }
+        for (unsigned partition = 0; partition < partitions_number; partition++)
+            std::copy(buffers[partition].items, buffers[partition].items + filled[partition],
+                      &scattered[cursors[partition]]);
     }
 
-    void insert(Holder &c)
+    std::array<std::unique_ptr<table_type>, partitions_number> partitions;
+};
+
+/*
+ * Bounded probe set of int_holder - Iter4_Broken_But_Fast made correct. Key lives in one of MaxProbe
+ * slots of its window home + j + j*j (j < MaxProbe, home = content % Size) or in stash: insert puts
+ * it to the first empty slot of window, to stash when whole window is taken. Table has padding
+ * behind Size slots, so windows don't wrap and there's no modulo per probe.
+ * member compares whole window, 4 slots per pcmpeqd, no branch and no stop on empty slot (like
+ * Iter4), stash is asked only when window says no: bit filter of stash keys first (2^18 bits, one
+ * bit per key), then sorted stash by branchless binary search. Nothing depends on probe chains,
+ * so erase just empties slot - no tombstones.
+ * Keys are in [0, INT_MAX]: negative one would have negative home and -1 is INF (empty slot), so
+ * insert throws std::out_of_range for them, member says no and erase does nothing.
+ */
+template<unsigned Size, unsigned MaxProbe = 8>
+class BoundedHashmap final
+{
+public:
+    static_assert((MaxProbe > 0) && (MaxProbe%4 == 0), "MaxProbe has to be multiple of 4");
+
+    static constexpr unsigned padding {(MaxProbe - 1) + (MaxProbe - 1)*(MaxProbe - 1)};
+
+    BoundedHashmap()
     {
-        const int i = process_search__false(c);
-        if (!(table[i] == c))
+        reset();
+    }
+
+    void insert(int_holder &c)
+    {
+        if (c.content < 0)
+            throw std::out_of_range("BoundedHashmap keys are non-negative");
+        if (member(c))
+            return;
+        const unsigned home = c.content % static_cast<int>(Size);
+        for (unsigned j = 0; j < MaxProbe; j++)
         {
-            table[i] = std::move(c);
-            n++;
+            int_holder &slot = table[home + j + j*j];
+            if (slot.is_empty())
+            {
+                slot.content = c.content;
+                n++;
+                return;
+            }
         }
+        stash.insert(std::upper_bound(stash.begin(), stash.end(), c.content), c.content);
+        set_filter_bit(c.content);
+        n++;
     }
 
-    void erase(Holder &c)
+    void erase(int_holder &c)
     {
-        const int i = process_search__true(c);
-        if (table[i] == c)
+        if (c.content < 0)
+            return;
+        const unsigned home = c.content % static_cast<int>(Size);
+        for (unsigned j = 0; j < MaxProbe; j++)
+        {
+            int_holder &slot = table[home + j + j*j];
+            if (slot.content == c.content)
+            {
+                slot.init_as_empty();
+                n--;
+                return;
+            }
+        }
+        auto it = std::lower_bound(stash.begin(), stash.end(), c.content);
+        if ((it != stash.end()) && (*it == c.content))
         {
-            c.mark = true;
+            // bit may be shared, filter is built again (stash is small)
+            stash.erase(it);
+            std::fill(stash_filter.begin(), stash_filter.end(), 0);
+            for (int key : stash)
+                set_filter_bit(key);
             n--;
         }
     }
 
-    bool member(Holder &c)
+    bool member(int_holder &c)
     {
-        int i = process_search__true(c);
-        return (table[i] == c);
+        if (c.content < 0)
+            return false;
+        const unsigned home = c.content % static_cast<int>(Size);
+        const __m128i key = _mm_set1_epi32(c.content);
+        __m128i found = _mm_setzero_si128();
+        for (unsigned j = 0; j < MaxProbe; j += 4)
+        {
+            const __m128i words = _mm_set_epi32(table[home + (j + 3) + (j + 3)*(j + 3)].content,
+                                                table[home + (j + 2) + (j + 2)*(j + 2)].content,
+                                                table[home + (j + 1) + (j + 1)*(j + 1)].content,
+                                                table[home + j + j*j].content);
+            found = _mm_or_si128(found, _mm_cmpeq_epi32(words, key));
+        }
+        return !_mm_testz_si128(found, found) || (filter_bit(c.content) && stash_member(c.content));
     }
 
-    bool find(Holder &c) { return member(c); }
+    bool find(int_holder &c) { return member(c); }
 
     unsigned size() const
     {
@@ -376,94 +2035,69 @@ public:
 
     unsigned capacity() const
     {
-        return table.size();
+        return Size;
     }
 
-    unsigned bucket_count() const
+    unsigned stash_size() const
     {
-        return capacity();
+        return stash.size();
     }
 
     void reset()
     {
-        n = 0;
-        collisions = 0;
         for (auto &e : table)
         {
             e.mark = false;
             e.init_as_empty();
         }
+        stash.clear();
+        std::fill(stash_filter.begin(), stash_filter.end(), 0);
+        n = 0;
     }
 
     void clear() { reset(); }
 
-    unsigned collisions {0};
-
-protected:
+private:
+    static constexpr unsigned filter_bits {18};
 
-    int process_search__true(Holder &c)
+    static uint32_t filter_index(int key)
     {
-        const int m = table.size();
-        const int hash_holder = Holder::hash(c, m);
-        int j = 0;
-        int i = Hash::h(hash_holder, j, m);
+        return (static_cast<uint32_t>(key)*2654435761u) >> (32 - filter_bits);
+    }
 
-        while ( !(table[i] == c) && (!table[i].is_empty()))
-        {
-            j++;
-            i = Hash::h(hash_holder, j, m);
-            collisions++;
-        }
-        return i;
+    bool filter_bit(int key) const
+    {
+        const uint32_t index = filter_index(key);
+        return (stash_filter[index/64] >> (index%64)) & 1;
     }
 
-    int process_search__false(Holder &c)
+    void set_filter_bit(int key)
     {
-        const int m = table.size();
-        const int hash_holder = Holder::hash(c, m);
-        int j = 0;
-        int i = Hash::h(hash_holder, j, m);
+        const uint32_t index = filter_index(key);
+        stash_filter[index/64] |= uint64_t(1) << (index%64);
+    }
 
-        while ( !(table[i] == c) && (!table[i].is_empty()) && !table[i].mark)
+    // last element <= key is found without branches on comparisons
+    bool stash_member(int key) const
+    {
+        const int *base = stash.data();
+        size_t length = stash.size();
+        while (length > 1)
         {
-            j++;
-            i = Hash::h(hash_holder, j, m);
-            collisions++;
+            const size_t half = length/2;
+            base += (base[half] <= key)? half : 0;
+            length -= half;
         }
-        return i;
+        return *base == key;
     }
 
     unsigned n {0};
+    std::vector<int> stash;
+    std::array<uint64_t, (1u << filter_bits)/64> stash_filter;
 public:
     static_assert((Size == 50000021) || (Size == 10000019) || (Size == 4000037) || (Size == 2000003) || (Size == 200003)
                   || (Size == 100003) || (Size == 500), "Size not supported");
-    std::array<Holder, Size> table;
-};
-
-template<unsigned Size, class Hash = Limited_quadratic_hash>
-class ExperimentalHashmap final : public Hashmap<Size, Hash>
-{
-public:
-    using Hashmap<Size, Hash>::n;
-    using Hashmap<Size, Hash>::table;
-    using Hashmap<Size, Hash>::process_search__true;
-
-    template<
-            template<unsigned> class Func = Iter3
-            >
-    bool fast_member(int_holder &c)
-    {
-        int i = 0;
-        if (n > (4*table.size()/5))
-        {
-            i = Func<Size>::process_search__true__optimized(table, c);
-        }
-        else
-        {
-            i = process_search__true(c);
-        }
-        return (table[i] == c);
-    }
+    std::array<int_holder, Size + padding> table;
 };
 
 class Linear_hash final
@@ -490,6 +2124,52 @@ public:
 	}
 };
 
+/*
+ * Quadratic probing between lines, linear inside them: table is cut to lines of line_slots
+ * (12 int_holders = 60B, about one cache line), probes 0..11 visit home line from home slot on
+ * (wrapping inside the line), then the next 12 go to line + 1, then line - 1, line + 4, line - 4, ...
+ * So one miss costs one line while long chains still spread like quadratic ones. Number of lines
+ * is prime = 3 mod 4 (lines_of) - then +-t*t steps visit every line once in first lines steps (plain
+ * t + t*t over m/12 lines reached only part of them and chain could run forever). k is home slot
+ * in [0, m), slots behind lines_of(m)*line_slots are never used (128 of 500, < 0.3% of the others).
+ */
+class Bucketized_quadratic_hash final
+{
+public:
+    static constexpr int line_slots {12};
+
+    // largest prime = 3 mod 4 not over m/line_slots, for sizes allowed by Hashmap
+    static constexpr int lines_of(int m)
+    {
+        switch (m)
+        {
+        case 50000021: return 4166651;
+        case 10000019: return 833299;
+        case 4000037: return 333331;
+        case 2000003: return 166643;
+        case 200003: return 16651;
+        case 100003: return 8311;
+        case 500: return 31;
+        }
+        throw std::invalid_argument("Bucketized_quadratic_hash: size not supported");
+    }
+
+    // t-th line of probe sequence from home_line (< lines): home_line, +1, -1, +4, -4, +9, ...
+    static int line(int home_line, int t, int lines)
+    {
+        const uint64_t step = (t + 1)/2;
+        const int offset = static_cast<int>(step*step%static_cast<unsigned>(lines));
+        const int result = (t & 1)? home_line + offset : home_line - offset;
+        return (result >= lines)? result - lines : (result < 0)? result + lines : result;
+    }
+
+    static int h(int k, int j, int m)
+    {
+        const int lines = lines_of(m);
+        return line((k/line_slots)%lines, j/line_slots, lines)*line_slots + (k + j)%line_slots;
+    }
+};
+
 /*
  * in our benchmark uniwersum is limited by 10^9 so long long arithmetic and conversions in h are useless
  */
@@ -547,6 +2227,120 @@ public:
 	}
 };
 
+/*
+ * Key hash policies: key -> home slot in [0, m).
+ */
+class Holder_hash final
+{
+public:
+    template<class Holder>
+    static int hash(Holder &c, int m)
+    {
+        return Holder::hash(c, m);
+    }
+
+    template<class Holder, class Key>
+    static int hash_key(const Key &key, int m)
+    {
+        return Holder::hash(key, m);
+    }
+
+    // only when Holder has batch kernel, Hashmap::member_batch falls back to hash() per key
+    template<class Holder>
+    static auto hash_batch(const Holder *keys, unsigned n, int m, int *hashes)
+        -> decltype(Holder::hash_batch(keys, n, m, hashes), void())
+    {
+        Holder::hash_batch(keys, n, m, hashes);
+    }
+};
+
+// multiply-shift instead of modulo, result is in [0, m) for any h
+static inline int reduce(uint32_t h, int m)
+{
+    return static_cast<int>((static_cast<uint64_t>(h) * static_cast<uint32_t>(m)) >> 32);
+}
+
+// murmur3 finalizer
+static inline uint32_t fmix32(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+// murmur3 64-bit finalizer, last xorshift folds high half into low 32 bits
+static inline uint64_t fmix64(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// one multiply by 2^32/phi (Fibonacci hashing) + xorshift
+static inline uint32_t multiply_xorshift32(uint32_t h)
+{
+    h *= 0x9e3779b1;
+    return h ^ (h >> 16);
+}
+
+// same by 2^64/phi, high half of product xored into low 32 bits
+static inline uint64_t multiply_xorshift64(uint64_t h)
+{
+    h *= 0x9e3779b97f4a7c15ULL;
+    return h ^ (h >> 32);
+}
+
+/*
+ * Keys up to 4B are mixed as uint32_t, 8B ones (int64_holder, uint64_holder) by 64-bit variant -
+ * cutting them to uint32_t put keys differing in high half into one home slot.
+ */
+class Murmur_hash final
+{
+public:
+    template<class Holder>
+    static int hash(const Holder &c, int m)
+    {
+        if constexpr (sizeof(c.content) > 4)
+            return reduce(static_cast<uint32_t>(fmix64(static_cast<uint64_t>(c.content))), m);
+        else
+            return reduce(fmix32(static_cast<uint32_t>(c.content)), m);
+    }
+};
+
+class Multiply_xorshift_hash final
+{
+public:
+    template<class Holder>
+    static int hash(const Holder &c, int m)
+    {
+        if constexpr (sizeof(c.content) > 4)
+            return reduce(static_cast<uint32_t>(multiply_xorshift64(static_cast<uint64_t>(c.content))), m);
+        else
+            return reduce(multiply_xorshift32(static_cast<uint32_t>(c.content)), m);
+    }
+};
+
+#ifdef __SSE4_2__
+class Crc32c_hash final
+{
+public:
+    template<class Holder>
+    static int hash(const Holder &c, int m)
+    {
+        if constexpr (sizeof(c.content) > 4)
+            return reduce(static_cast<uint32_t>(_mm_crc32_u64(0, static_cast<uint64_t>(c.content))), m);
+        else
+            return reduce(_mm_crc32_u32(0, static_cast<uint32_t>(c.content)), m);
+    }
+};
+#endif
+
 struct __attribute__ ((aligned (16))) hash_vec
 {
     int i0, i1, i2, i3;
@@ -670,9 +2464,14 @@ struct Iter3 final
     // optimized when  quadratic alpha > 0.85 =>  avg quadratic comparisions per search ~ 7
     // quadratic alpha > 0.75 => avg quadratic comparisions per search ~ 3.7
     static int process_search__true__optimized(std::array<int_holder, Size> &table, int_holder &c)
+    {
+        return process_search__true__optimized(table, c, c.content % static_cast<int>(table.size()));
+    }
+
+    // hc - home slot from key hash policy
+    static int process_search__true__optimized(std::array<int_holder, Size> &table, int_holder &c, int hc)
     {
         const int m = table.size();
-        const int hc = c.content % m;
         hash_vec v;
         hash_vec jj = {0, 1, 2, 3};
         hash_vec zer = {0, 0, 0, 0};
@@ -733,6 +2532,130 @@ struct Iter3 final
     }
 };
 
+/*
+ * Iter3 on 8 lanes: probes j .. j + 7 at once, slot contents by one vpgatherdd (offsets 5*slot,
+ * scale 1 - int_holder is packed 5B). No modulo in the loop - slots and their steps to the next
+ * group (16j + 72, growing by 128) are kept in [0, m) by compare and subtract, so lanes are
+ * exactly (hc + j + j^2)%m like in Iter3. Needs m > 184, target attribute, caller checks has_avx2().
+ */
+template<unsigned Size>
+struct Iter3_avx2 final
+{
+    __attribute__((target("avx2")))
+    static int process_search__true__optimized(std::array<int_holder, Size> &table, int_holder &c, int hc)
+    {
+        static_assert(Size > 184, "steps have to be below m");
+        const __m256i m = _mm256_set1_epi32(Size);
+        const __m256i top = _mm256_set1_epi32(Size - 1);
+        const __m256i key = _mm256_set1_epi32(c.content);
+        const __m256i empty = _mm256_set1_epi32(INF);
+        const __m256i growth = _mm256_set1_epi32(128);
+        const __m256i j = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const char *bytes = reinterpret_cast<const char*>(table.data());
+        const int *base = reinterpret_cast<const int*>(bytes);
+
+        __m256i slots = reduce(_mm256_add_epi32(_mm256_set1_epi32(hc), _mm256_add_epi32(j, _mm256_mullo_epi32(j, j))),
+                               m, top);
+        __m256i steps = _mm256_add_epi32(_mm256_slli_epi32(j, 4), _mm256_set1_epi32(72));
+        for (;;)
+        {
+            const __m256i offsets = _mm256_add_epi32(_mm256_slli_epi32(slots, 2), slots);
+            const __m256i contents = _mm256_i32gather_epi32(base, offsets, 1);
+            const __m256i stop = _mm256_or_si256(_mm256_cmpeq_epi32(contents, key),
+                                                 _mm256_cmpeq_epi32(contents, empty));
+            const int mask = _mm256_movemask_ps(_mm256_castsi256_ps(stop));
+            if (mask)
+            {
+                alignas(32) int lanes[8];
+                _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), slots);
+                return lanes[__builtin_ctz(mask)];
+            }
+            slots = reduce(_mm256_add_epi32(slots, steps), m, top);
+            steps = reduce(_mm256_add_epi32(steps, growth), m, top);
+        }
+    }
+
+private:
+    // v in [0, 2m) -> v % m
+    __attribute__((target("avx2")))
+    static __m256i reduce(__m256i v, __m256i m, __m256i top)
+    {
+        return _mm256_sub_epi32(v, _mm256_and_si256(_mm256_cmpgt_epi32(v, top), m));
+    }
+};
+
+/*
+ * Iter3 for basic_key_holder: no sign bit to test, so emptiness is occupied flags of 4 probed
+ * slots gathered to 4-bit mask, keys are compared in SIMD - 4 x 32-bit in one pcmpeqd or
+ * 2 x 64-bit per pcmpeqq. Stop on first lane which is empty or occupied with key.
+ */
+template<unsigned Size, class Holder>
+struct Iter3_key final
+{
+    static int process_search__true__optimized(std::array<Holder, Size> &table, Holder &c, int hc)
+    {
+        static_assert(sizeof(c.content) == 4 || sizeof(c.content) == 8, "32 or 64-bit keys only");
+        const int m = table.size();
+        for (int j = 0;; j += 4)
+        {
+            const int v0 = (hc + j + j*j)%m;
+            const int v1 = (hc + (j + 1) + (j + 1)*(j + 1))%m;
+            const int v2 = (hc + (j + 2) + (j + 2)*(j + 2))%m;
+            const int v3 = (hc + (j + 3) + (j + 3)*(j + 3))%m;
+            const int occupied = table[v0].occupied | (table[v1].occupied << 1) |
+                                 (table[v2].occupied << 2) | (table[v3].occupied << 3);
+            int equal;
+            if constexpr (sizeof(c.content) == 8)
+            {
+                const __m128i key = _mm_set1_epi64x(c.content);
+                const __m128i low = _mm_set_epi64x(table[v1].content, table[v0].content);
+                const __m128i high = _mm_set_epi64x(table[v3].content, table[v2].content);
+                equal = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(low, key))) |
+                        (_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(high, key))) << 2);
+            }
+            else
+            {
+                const __m128i key = _mm_set1_epi32(c.content);
+                const __m128i words = _mm_set_epi32(table[v3].content, table[v2].content,
+                                                    table[v1].content, table[v0].content);
+                equal = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(words, key)));
+            }
+            const int stop = (equal & occupied) | (~occupied & 0xf);
+            if (stop)
+            {
+                const int lanes[4] {v0, v1, v2, v3};
+                return lanes[__builtin_ctz(stop)];
+            }
+        }
+    }
+};
+
+/*
+ * Iter3 for Bucketized_quadratic_hash: whole line (12 slots) is one int_holder::stop_mask - 6 loads
+ * and 3 x 2 pcmpeqd, mask is rotated by home offset so bits come in probe order, first set bit is
+ * the slot process_search__true would stop on.
+ */
+template<unsigned Size>
+struct Iter_line final
+{
+    static int process_search__true__optimized(std::array<int_holder, Size> &table, int_holder &c, int hc)
+    {
+        constexpr int line_slots = Bucketized_quadratic_hash::line_slots;
+        constexpr int lines = Bucketized_quadratic_hash::lines_of(Size);
+        constexpr unsigned all = (1u << line_slots) - 1;
+        const int offset = hc%line_slots;
+        const int home_line = (hc/line_slots)%lines;
+        for (int t = 0;; t++)
+        {
+            const int first = Bucketized_quadratic_hash::line(home_line, t, lines)*line_slots;
+            const unsigned stop = int_holder::stop_mask<line_slots/4>(&table[first], c.content);
+            const unsigned rotated = ((stop >> offset) | (stop << (line_slots - offset))) & all;
+            if (rotated)
+                return first + (offset + __builtin_ctz(rotated))%line_slots;
+        }
+    }
+};
+
 //// optimized when  quadratic alpha > 0.85 =>  avg quadratic comparisions per search ~ 7
 //// quadratic alpha > 0.75 => avg quadratic comparisions per search ~ 3.7
 //static int process_search__true__optimized__iter2(std::vector<int_holder> &table, int_holder &c)
@@ -0,0 +1,181 @@
+#ifndef INTERN_POOL_HPP
+#define INTERN_POOL_HPP
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <x86intrin.h>
+
+#include "hashmap.hpp"
+#include "sstring.hpp"
+
+/*
+ * String interning: string <-> dense 32-bit id (0, 1, 2, .. in order of first intern).
+ *
+ * - strings live in open addressing table (Hashmap) as sstring: up to 7 chars inline in slot,
+ *   longer ones in append-only arena (arena_allocator, 1MB chunks). Nothing is ever erased, so
+ *   slot of string and its bytes never move - id -> string is id -> slot index (chunked array).
+ * - intern() hit path takes no lock: probe is validated by seqlock. Writer (misses, under mutex)
+ *   fills id -> slot entry, makes sequence odd, inserts, publishes id and makes it even again, reader
+ *   waits while sequence is odd and retries when it changed under it - so it's not lock-free, one
+ *   insert can hold readers back. Any id reader can find already resolves in str(). Torn reads are
+ *   harmless because slot content is one aligned 8B store (reader sees empty slot or whole pointer)
+ *   and arena bytes are written before it - x86 (TSO) only, like the rest of this code.
+ * - str(id) takes no lock and never waits, for ids below size() or returned by find()/intern().
+ * - table is fixed (Size) - intern() throws std::length_error over max_load_factor and for strings
+ *   longer than max_length.
+ * - one arena per Tag, claimed by the table, and pool frees it in destructor, so only one pool per
+ *   Tag may be alive - constructor throws std::logic_error otherwise. Pools living together need
+ *   distinct Tags.
+ */
+namespace interning
+{
+
+constexpr unsigned max_length {1u << 16};
+constexpr float max_load_factor {0.9f};
+
+struct default_tag {};
+
+template<unsigned Size, class Tag = default_tag>
+class intern_pool final
+{
+public:
+    using alloc_type = sstrings::arena_allocator<Tag>;
+    using holder_type = hashing_benchmark::basic_sstring_holder<max_length, alloc_type>;
+    using table_type = common::Hashmap<Size, holder_type, common::Limited_quadratic_hash>;
+
+    static constexpr uint32_t not_found {~0u};
+    static constexpr unsigned chunk_bits {16};
+    static constexpr unsigned chunk_ids {1u << chunk_bits};
+    static constexpr unsigned max_chunks {(Size >> chunk_bits) + 1};
+
+    intern_pool(const intern_pool &) = delete;
+    intern_pool& operator=(const intern_pool &) = delete;
+
+    intern_pool()
+        : table(new table_type())
+    {
+        for (auto &chunk : slots)
+            chunk.store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~intern_pool()
+    {
+        for (auto &chunk : slots)
+            delete[] chunk.load(std::memory_order_relaxed);
+        table.reset();
+        alloc_type::free_chunks();
+    }
+
+    uint32_t intern(std::string_view input)
+    {
+        const uint32_t id = find(input);
+        if (id != not_found)
+            return id;
+        return insert(input);
+    }
+
+    // no lock, waits only while insert is being published, not_found when input wasn't interned
+    uint32_t find(std::string_view input) const
+    {
+        const auto lookup = holder_type::lookup(input);
+        for (;;)
+        {
+            const uint64_t before = sequence.load(std::memory_order_acquire);
+            if (before & 1)
+            {
+                _mm_pause();
+                continue;
+            }
+            const int i = probe(lookup);
+            const uint32_t id = table->table[i].is_empty()? not_found : ids_of_slots()[i];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before)
+                return id;
+        }
+    }
+
+    // id has to be < size()
+    std::string_view str(uint32_t id) const
+    {
+        const uint32_t *chunk = slots[id >> chunk_bits].load(std::memory_order_acquire);
+        return table->table[chunk[id & (chunk_ids - 1)]].content;
+    }
+
+    uint32_t size() const
+    {
+        return count.load(std::memory_order_acquire);
+    }
+
+private:
+    // Hashmap::member counts collisions (shared counter), readers probe table on their own
+    int probe(const typename holder_type::lookup_key &lookup) const
+    {
+        const int m = Size;
+        const int hash_holder = holder_type::hash(lookup, m);
+        int j = 0;
+        int i = common::Limited_quadratic_hash::h(hash_holder, j, m);
+        while (!table->table[i].equals(lookup) && !table->table[i].is_empty())
+        {
+            j++;
+            i = common::Limited_quadratic_hash::h(hash_holder, j, m);
+        }
+        return i;
+    }
+
+    uint32_t insert(std::string_view input)
+    {
+        std::lock_guard<std::mutex> guard(writer);
+        const auto lookup = holder_type::lookup(input);
+        int i = probe(lookup);
+        if (!table->table[i].is_empty())
+            return ids_of_slots()[i];
+
+        const uint32_t id = count.load(std::memory_order_relaxed);
+        if (id + 1 > max_load_factor*Size)
+            throw std::length_error("intern pool is full");
+
+        holder_type holder;
+        holder.mark = false;
+        holder.content = sstrings::sstring<max_length, alloc_type>(input.data(), input.size());
+
+        uint32_t *chunk = slots[id >> chunk_bits].load(std::memory_order_relaxed);
+        if (!chunk)
+        {
+            chunk = new uint32_t[chunk_ids];
+            slots[id >> chunk_bits].store(chunk, std::memory_order_release);
+        }
+        // before id is published in slot_ids, so str(find(input)) never reads unwritten entry
+        chunk[id & (chunk_ids - 1)] = i;
+
+        sequence.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        ids_of_slots()[i] = id;
+        table->insert(holder);
+        std::atomic_thread_fence(std::memory_order_release);
+        sequence.fetch_add(1, std::memory_order_release);
+
+        count.store(id + 1, std::memory_order_release);
+        return id;
+    }
+
+    uint32_t* ids_of_slots() const
+    {
+        return slot_ids.get();
+    }
+
+    std::unique_ptr<table_type> table;
+    // slot -> id, separate array so slot stays basic_sstring_holder (16B)
+    std::unique_ptr<uint32_t[]> slot_ids {new uint32_t[Size]};
+    // id -> slot, chunks never move so readers need no lock
+    std::atomic<uint32_t*> slots[max_chunks];
+    std::atomic<uint32_t> count {0};
+    std::atomic<uint64_t> sequence {0};
+    std::mutex writer;
+};
+
+}
+
+#endif // INTERN_POOL_HPP
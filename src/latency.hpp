@@ -0,0 +1,214 @@
+#ifndef LATENCY_HPP
+#define LATENCY_HPP
+
+#include <cstdio>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+#include <algorithm>
+#include <x86intrin.h>
+
+/*
+ * Per operation latency, because realtime_now() around whole loop gives only average.
+ *
+ * - timer reads TSC (rdtsc/rdtscp + lfence, so op can't be reordered outside of region).
+ *   Ticks -> ns ratio is calibrated once against CLOCK_MONOTONIC and cost of empty region
+ *   (median of many) is subtracted from every sample.
+ * - histogram is HDR-like: values < 32 have exact buckets, bigger ones have 32 linear sub-buckets
+ *   per power of 2, so relative error is < 1/32 and whole uint64_t range fits in 1920 counters.
+ *   Percentile reports upper bound of bucket.
+ * - timing every op would cost ~2 rdtsc per op and serializes pipeline, that's why callers sample
+ *   every n-th op or time ops in separate pass (sample()) after timed loop.
+ */
+namespace latency
+{
+
+class timer final
+{
+public:
+    timer()
+    {
+        calibrate();
+    }
+
+    static inline uint64_t start()
+    {
+        _mm_lfence();
+        return __rdtsc();
+    }
+
+    static inline uint64_t stop()
+    {
+        unsigned aux;
+        const uint64_t ticks = __rdtscp(&aux);
+        _mm_lfence();
+        return ticks;
+    }
+
+    uint64_t to_ns(uint64_t ticks) const
+    {
+        return (ticks > overhead)? static_cast<uint64_t>((ticks - overhead)*ns_per_tick) : 0;
+    }
+
+    double overhead_ns() const
+    {
+        return overhead*ns_per_tick;
+    }
+
+private:
+    static uint64_t monotonic_now()
+    {
+        struct timespec now_ts;
+        clock_gettime(CLOCK_MONOTONIC, &now_ts);
+        return now_ts.tv_sec * 1000000000ULL + now_ts.tv_nsec;
+    }
+
+    void calibrate()
+    {
+        constexpr uint64_t calibration_ns {20000000};
+        const uint64_t ns0 = monotonic_now();
+        const uint64_t ticks0 = start();
+        uint64_t ns1;
+        do
+        {
+            ns1 = monotonic_now();
+        } while (ns1 - ns0 < calibration_ns);
+        const uint64_t ticks1 = stop();
+        ns_per_tick = (ns1 - ns0)*1.0/(ticks1 - ticks0);
+
+        constexpr unsigned samples {10001};
+        std::vector<uint64_t> empty;
+        empty.reserve(samples);
+        for (unsigned i = 0; i < samples; i++)
+        {
+            const uint64_t t0 = start();
+            const uint64_t t1 = stop();
+            empty.push_back(t1 - t0);
+        }
+        std::nth_element(empty.begin(), empty.begin() + samples/2, empty.end());
+        overhead = empty[samples/2];
+    }
+
+    double ns_per_tick {1.0};
+    uint64_t overhead {0};
+};
+
+static inline const timer& default_timer()
+{
+    static const timer instance;
+    return instance;
+}
+
+class histogram final
+{
+public:
+    static constexpr unsigned sub_bucket_bits {5};
+    static constexpr unsigned sub_buckets {1u << sub_bucket_bits};
+    static constexpr unsigned buckets_number {sub_buckets*(64 - sub_bucket_bits + 1)};
+
+    histogram()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(buckets, buckets + buckets_number, 0);
+        samples = 0;
+        max_value = 0;
+        sum = 0;
+    }
+
+    void record(uint64_t value)
+    {
+        buckets[index(value)]++;
+        samples++;
+        sum += value;
+        if (value > max_value)
+            max_value = value;
+    }
+
+    void merge(const histogram &another)
+    {
+        for (unsigned i = 0; i < buckets_number; i++)
+            buckets[i] += another.buckets[i];
+        samples += another.samples;
+        sum += another.sum;
+        max_value = std::max(max_value, another.max_value);
+    }
+
+    // p in [0, 100]
+    uint64_t percentile(double p) const
+    {
+        if (samples == 0)
+            return 0;
+        uint64_t rank = static_cast<uint64_t>(p/100.0*samples + 0.5);
+        rank = std::max<uint64_t>(rank, 1);
+        uint64_t seen = 0;
+        for (unsigned i = 0; i < buckets_number; i++)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+                return std::min(upper_bound(i), max_value);
+        }
+        return max_value;
+    }
+
+    uint64_t count() const { return samples; }
+    uint64_t max() const { return max_value; }
+    double mean() const { return samples? sum*1.0/samples : 0.0; }
+
+    void print(const char *name) const
+    {
+        printf("%s latency: p50 = %lu ns, p90 = %lu ns, p99 = %lu ns, p99.9 = %lu ns, max = %lu ns, "
+               "samples = %lu\n", name, percentile(50.0), percentile(90.0), percentile(99.0),
+               percentile(99.9), max(), count());
+    }
+
+private:
+    static unsigned index(uint64_t value)
+    {
+        if (value < sub_buckets)
+            return value;
+        const unsigned magnitude = 63 - __builtin_clzll(value);
+        const unsigned shift = magnitude - sub_bucket_bits;
+        const unsigned sub = (value >> shift) & (sub_buckets - 1);
+        return sub_buckets + shift*sub_buckets + sub;
+    }
+
+    static uint64_t upper_bound(unsigned i)
+    {
+        if (i < sub_buckets)
+            return i;
+        const unsigned shift = (i - sub_buckets)/sub_buckets;
+        const uint64_t sub = (i - sub_buckets)%sub_buckets;
+        return ((sub_buckets + sub + 1) << shift) - 1;
+    }
+
+    uint64_t buckets[buckets_number];
+    uint64_t samples;
+    uint64_t max_value;
+    uint64_t sum;
+};
+
+/*
+ * Separate pass of samples timed operations op(i), so timed loop of benchmark isn't disturbed.
+ */
+template<class Op>
+static histogram sample(unsigned samples, Op &&op)
+{
+    const timer &clock = default_timer();
+    histogram result;
+    for (unsigned i = 0; i < samples; i++)
+    {
+        const uint64_t ticks0 = clock.start();
+        op(i);
+        const uint64_t ticks1 = clock.stop();
+        result.record(clock.to_ns(ticks1 - ticks0));
+    }
+    return result;
+}
+
+}
+
+#endif // LATENCY_HPP
@@ -0,0 +1,173 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * Hardware counters around timed region, instead of hand-pasted 'perf stat' dumps.
+ *
+ * - every counter is opened separately (not as group) so when CPU/VM/perf_event_paranoid
+ *   doesn't allow one of them the rest still works. Unavailable counters are reported
+ *   once on stderr and skipped in results.
+ * - only user space is counted (exclude_kernel), that's what perf_event_paranoid = 2 allows
+ * - when kernel multiplexes counters value is scaled by time_enabled/time_running
+ */
+namespace perf
+{
+
+enum counter
+{
+    cycles,
+    instructions,
+    llc_misses,
+    dtlb_misses,
+    branch_misses,
+    counters_number
+};
+
+class counters final
+{
+public:
+    counters(const counters &) = delete;
+    counters& operator=(const counters &) = delete;
+
+    counters()
+    {
+        for (unsigned i = 0; i < counters_number; i++)
+        {
+            fds[i] = open_counter(static_cast<counter>(i));
+            values[i] = 0;
+        }
+    }
+
+    ~counters()
+    {
+        for (auto fd : fds)
+            if (fd >= 0)
+                close(fd);
+    }
+
+    bool available(counter c) const
+    {
+        return fds[c] >= 0;
+    }
+
+    bool any_available() const
+    {
+        for (auto fd : fds)
+            if (fd >= 0)
+                return true;
+        return false;
+    }
+
+    void start()
+    {
+        for (auto fd : fds)
+            if (fd >= 0)
+            {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+    }
+
+    void stop()
+    {
+        for (auto fd : fds)
+            if (fd >= 0)
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+        for (unsigned i = 0; i < counters_number; i++)
+        {
+            values[i] = 0;
+            if (fds[i] < 0)
+                continue;
+            uint64_t data[3] = {0, 0, 0};
+            if (read(fds[i], data, sizeof data) != sizeof data)
+                continue;
+            // data = {value, time_enabled, time_running}
+            values[i] = (data[2] > 0 && data[2] < data[1])?
+                        static_cast<uint64_t>(data[0]*(data[1]*1.0/data[2])) : data[0];
+        }
+    }
+
+    uint64_t value(counter c) const
+    {
+        return values[c];
+    }
+
+    static const char* name(counter c)
+    {
+        static const char *names[counters_number] = {"cycles", "instructions", "llc_misses",
+                                                     "dtlb_misses", "branch_misses"};
+        return names[c];
+    }
+
+private:
+    static int open_counter(counter c)
+    {
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof attr);
+        attr.size = sizeof attr;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        switch (c)
+        {
+        case cycles:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case instructions:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case llc_misses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case dtlb_misses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case branch_misses:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        default:
+            return -1;
+        }
+
+        const int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd < 0)
+            warn_once(c);
+        return fd;
+    }
+
+    static void warn_once(counter c)
+    {
+        static bool warned[counters_number] = {false};
+        if (!warned[c])
+        {
+            fprintf(stderr, "perf counter %s unavailable: %s\n", name(c), strerror(errno));
+            warned[c] = true;
+        }
+    }
+
+    int fds[counters_number];
+    uint64_t values[counters_number];
+};
+
+}
+
+#endif // PERF_COUNTERS_HPP
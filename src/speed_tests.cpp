@@ -1,4 +1,7 @@
 #include "hashmap.hpp"
+#include "perf_counters.hpp"
+#include "latency.hpp"
+#include "distribution.hpp"
 
 namespace benchmarks
 {
@@ -21,6 +24,23 @@ static inline char get_operation()
     return (rand()%2 == 1)? 'I' : 'M';
 }
 
+/*
+ * Counters of timed region only, so setup and data preprocessing don't pollute them
+ * like in 'perf stat' dumps below.
+ */
+static void print_counters(const perf::counters &counters, unsigned operations)
+{
+    if (!counters.any_available())
+        return;
+    for (unsigned i = 0; i < perf::counters_number; i++)
+    {
+        const auto c = static_cast<perf::counter>(i);
+        if (counters.available(c))
+            printf("%s/op = %.3f ", perf::counters::name(c), counters.value(c)*1.0/operations);
+    }
+    printf("\n");
+}
+
 /* This benchmark test only I+M.
  *
  * TO DO:
@@ -64,6 +84,8 @@ static void benchmark()
     }
 
     printf("Hashmap start watch\n");
+    perf::counters counters;
+    counters.start();
     uint64_t t0 = realtime_now();
     for (unsigned i = 0; i < operations_number; i++)
     {
@@ -88,11 +110,14 @@ static void benchmark()
             }
     }
     uint64_t t1 = realtime_now();
+    counters.stop();
     uint64_t time_ms = (t1 - t0)/1000000;
     printf("Hashmap stop watch: Time = %lu ms.\n", time_ms);
+    print_counters(counters, operations_number);
 
 
     printf("STL Map start watch\n");
+    counters.start();
     t0 = realtime_now();
     for (unsigned i = 0; i < operations_number; i++)
     {
@@ -117,11 +142,14 @@ static void benchmark()
             }
     }
     t1 = realtime_now();
+    counters.stop();
     time_ms = (t1 - t0)/1000000;
     printf("STL Map stop watch: Time = %lu ms.\n", time_ms);
+    print_counters(counters, operations_number);
 
 
     printf("STL Unordered Map start watch\n");
+    counters.start();
     t0 = realtime_now();
     for (unsigned i = 0; i < operations_number; i++)
     {
@@ -146,8 +174,10 @@ static void benchmark()
             }
     }
     t1 = realtime_now();
+    counters.stop();
     time_ms = (t1 - t0)/1000000;
     printf("STL Unordered Map stop watch: Time = %lu ms.\n", time_ms);
+    print_counters(counters, operations_number);
 
 
     printf("Summary\n");
@@ -198,6 +228,8 @@ static void benchmark__only_hashmap()
     }
 
     printf("Hashmap start watch\n");
+    perf::counters counters;
+    counters.start();
     uint64_t t0 = realtime_now();
     for (unsigned i = 0; i < operations_number; i++)
     {
@@ -222,8 +254,10 @@ static void benchmark__only_hashmap()
             }
     }
     uint64_t t1 = realtime_now();
+    counters.stop();
     uint64_t time_ms = (t1 - t0)/1000000;
     printf("Hashmap stop watch: Time = %lu ms.\n", time_ms);
+    print_counters(counters, operations_number);
 
     printf("Summary\n");
     printf("inserts = %d, members = %d, hits = %d, hashmap.size = %d\n",
@@ -385,7 +419,7 @@ static void test_intrinsics3()
  */
 static void benchmark__only_hashmap_basic_for_member()
 {
-    static common::ExperimentalHashmap<200003, common::int_holder> hash_map;
+    static common::ExperimentalHashmap<200003> hash_map;
 
     constexpr unsigned uniwersum_size {1000000000};
 
@@ -421,6 +455,8 @@ static void benchmark__only_hashmap_basic_for_member()
     }
 
     printf("Hashmap start watch\n");
+    perf::counters counters;
+    counters.start();
     uint64_t t0 = realtime_now();
     for (unsigned i = 0; i < queries; i++)
     {
@@ -429,8 +465,18 @@ static void benchmark__only_hashmap_basic_for_member()
     }
 
     uint64_t t1 = realtime_now();
+    counters.stop();
     uint64_t time_ms = (t1 - t0)/1000000;
     printf("Hashmap stop watch: Time = %lu ms.\n", time_ms);
+    print_counters(counters, queries);
+
+    constexpr unsigned latency_samples = 1000000;
+    unsigned latency_hits = 0;
+    auto find_latency = latency::sample(latency_samples, [&](unsigned i){
+        basic_config.content = members[i%fixed_members];
+        latency_hits += hash_map.fast_member(basic_config);
+    });
+    find_latency.print("fast_member");
 
     printf("Summary\n");
     printf("inserts = %d, members = %d, hits = %d, hashmap.size = %d\n",
@@ -442,6 +488,723 @@ static void benchmark__only_hashmap_basic_for_member()
     printf("OK :)\n");
 }
 
+/*
+ * Iter3 (int_holder, INF reserved) vs Iter3_key (out of band empty) at 0.95 load, the same
+ * 190000 keys in 200003 table and 1024 fixed queries (mostly misses) as above. Keys of 64-bit holders
+ * are spread over whole domain (negative too).
+ */
+template<class Table, class Holder>
+static void key_holder_for_member(const char *name, Table &hash_map, std::vector<uint64_t> &keys,
+                                  std::vector<uint64_t> &members)
+{
+    constexpr unsigned queries = 60000000;
+    using key_type = decltype(Holder::content);
+    hash_map.reset();
+
+    Holder c;
+    c.mark = false;
+    for (auto key : keys)
+    {
+        c.content = static_cast<key_type>(key);
+        hash_map.insert(c);
+    }
+
+    unsigned hits {0};
+    uint64_t t0 = realtime_now();
+    for (unsigned i = 0; i < queries; i++)
+    {
+        c.content = static_cast<key_type>(members[i%members.size()]);
+        hits += hash_map.member(c);
+    }
+    uint64_t t1 = realtime_now();
+    const uint64_t member_ns = t1 - t0;
+
+    t0 = realtime_now();
+    for (unsigned i = 0; i < queries; i++)
+    {
+        c.content = static_cast<key_type>(members[i%members.size()]);
+        hits += hash_map.fast_member(c);
+    }
+    t1 = realtime_now();
+    printf("%-14s sizeof = %2zu, size/capacity = %.2f, member = %.1fns, fast_member = %.1fns, hits = %u\n", name,
+           sizeof(Holder), hash_map.size()*1.0/hash_map.capacity(), member_ns*1.0/queries, (t1 - t0)*1.0/queries,
+           hits);
+}
+
+static void benchmark__key_holders_for_member()
+{
+    static common::ExperimentalHashmap<200003> int_map;
+    static common::ExperimentalKeyHashmap<200003, common::uint32_holder> uint32_map;
+    static common::ExperimentalKeyHashmap<200003, common::int64_holder> int64_map;
+    static common::ExperimentalKeyHashmap<200003, common::uint64_holder> uint64_map;
+
+    constexpr unsigned uniwersum_size {1000000000};
+    constexpr unsigned inserts = 190000;
+    constexpr unsigned fixed_members = 1024;
+
+    printf("\n%s\n\n", __FUNCTION__);
+    srand(time(nullptr));
+    auto random64 = []()
+    {
+        return (static_cast<uint64_t>(rand()) << 33) ^ (static_cast<uint64_t>(rand()) << 11) ^ rand();
+    };
+    std::vector<uint64_t> small_keys, small_members, wide_keys, wide_members;
+    for (unsigned i = 0; i < inserts; i++)
+    {
+        small_keys.push_back(rand()%uniwersum_size);
+        wide_keys.push_back(random64());
+    }
+    for (unsigned i = 0; i < fixed_members; i++)
+    {
+        small_members.push_back(rand()%uniwersum_size);
+        wide_members.push_back(random64());
+    }
+
+    key_holder_for_member<decltype(int_map), common::int_holder>("int_holder", int_map, small_keys, small_members);
+    key_holder_for_member<decltype(uint32_map), common::uint32_holder>("uint32_holder", uint32_map, small_keys,
+                                                                       small_members);
+    key_holder_for_member<decltype(int64_map), common::int64_holder>("int64_holder", int64_map, wide_keys,
+                                                                     wide_members);
+    key_holder_for_member<decltype(uint64_map), common::uint64_holder>("uint64_holder", uint64_map, wide_keys,
+                                                                       wide_members);
+    printf("OK :)\n");
+}
+
+
+/*
+ * Full scan of 50M slots table (250MB) at different fill: hand written loop over table
+ * (like real_test_case_only_hashmap), begin()/end() and for_each (live_mask, 16 slots per mask).
+ * GB/s is table size / scan time.
+ */
+static void benchmark__scan()
+{
+    static common::Hashmap<50000021> hash_map;
+    constexpr unsigned rounds = 5;
+    const double table_gb = sizeof(hash_map.table)/1e9;
+
+    printf("\n%s\n\n", __FUNCTION__);
+    srand(time(nullptr));
+    common::int_holder c;
+    c.mark = false;
+    for (double fill : {0.01, 0.1, 0.5})
+    {
+        while (hash_map.size() < fill*hash_map.capacity())
+        {
+            c.content = rand()%1000000000;
+            hash_map.insert(c);
+        }
+
+        auto report = [&](const char *name, auto &&scan)
+        {
+            uint64_t sum {0};
+            const uint64_t t0 = realtime_now();
+            for (unsigned round = 0; round < rounds; round++)
+                sum += scan();
+            const uint64_t t1 = realtime_now();
+            printf("fill = %.2f, %-10s %.2f GB/s, %.1f ms per scan, sum = %lu\n", fill, name,
+                   rounds*table_gb/((t1 - t0)/1e9), (t1 - t0)/1e6/rounds, sum);
+        };
+        report("loop", [&]()
+        {
+            uint64_t sum {0};
+            for (auto &holder : hash_map.table)
+                if (!holder.is_empty() && !holder.mark)
+                    sum += holder.content;
+            return sum;
+        });
+        report("iterator", [&]()
+        {
+            uint64_t sum {0};
+            for (auto &holder : hash_map)
+                sum += holder.content;
+            return sum;
+        });
+        report("for_each", [&]()
+        {
+            uint64_t sum {0};
+            hash_map.for_each([&](common::int_holder &holder) { sum += holder.content; });
+            return sum;
+        });
+    }
+    printf("OK :)\n");
+}
+
+static void benchmark__erase_if()
+{
+    static common::Hashmap<50000021> hash_map;
+    constexpr unsigned keys_number = 10000000;
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+    printf("\n%s\n\n", __FUNCTION__);
+    srand(time(nullptr));
+    std::vector<int> keys;
+    keys.reserve(keys_number);
+    auto fill = [&]()
+    {
+        hash_map.reset();
+        common::int_holder c;
+        c.mark = false;
+        for (int key : keys)
+        {
+            c.content = key;
+            hash_map.insert(c);
+        }
+    };
+    common::int_holder c;
+    c.mark = false;
+    while (hash_map.size() < keys_number)
+    {
+        c.content = rand()%1000000000;
+        const unsigned before = hash_map.size();
+        hash_map.insert(c);
+        if (hash_map.size() != before)
+            keys.push_back(c.content);
+    }
+
+    for (int tenths : {1, 5, 9})
+    {
+        auto erased = [tenths](const common::int_holder &holder) { return holder.content%10 < tenths; };
+        auto report = [&](const char *name, auto &&erase)
+        {
+            fill();
+            const uint64_t t0 = realtime_now();
+            erase();
+            const uint64_t t1 = realtime_now();
+            printf("erase %d0%%, %-22s %.1f ms, size = %u, tombstones = %u\n", tenths, name,
+                   (t1 - t0)/1e6, hash_map.size(), hash_map.tombstones());
+        };
+        report("erase loop", [&]()
+        {
+            for (int key : keys)
+                if (key%10 < tenths)
+                {
+                    c.content = key;
+                    hash_map.erase(c);
+                }
+        });
+        report("erase_if, 1 thread", [&]() { hash_map.erase_if(erased, 1, 1.0f); });
+        char name[32];
+        snprintf(name, sizeof(name), "erase_if, %u threads", threads);
+        report(name, [&]() { hash_map.erase_if(erased, threads, 1.0f); });
+        report("erase_if + purge", [&]() { hash_map.erase_if(erased, threads, 0.0f); });
+    }
+    printf("OK :)\n");
+}
+
+static void benchmark__set_algebra()
+{
+    using table_type = common::Hashmap<10000019>;
+    static table_type a, b, result;
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+    printf("\n%s\n\n", __FUNCTION__);
+    srand(time(nullptr));
+    for (unsigned a_number : {1000000u, 5000000u})
+    {
+        constexpr unsigned b_number = 5000000;
+        std::vector<int> a_keys, b_keys;
+        auto fill = [](table_type &table, std::vector<int> &keys, unsigned keys_number)
+        {
+            table.reset();
+            keys.clear();
+            common::int_holder c;
+            c.mark = false;
+            while (table.size() < keys_number)
+            {
+                // x -> x*654435761 mod 10^9 is injective, so a and b overlap like rand()%10^7 but keys
+                // are spread over the table (plain keys < capacity would be visited in slot order)
+                c.content = static_cast<int>(static_cast<uint64_t>(rand()%10000000)*654435761u%1000000000);
+                const unsigned before = table.size();
+                table.insert(c);
+                if (table.size() != before)
+                    keys.push_back(c.content);
+            }
+            std::sort(keys.begin(), keys.end());
+        };
+        fill(a, a_keys, a_number);
+        fill(b, b_keys, b_number);
+
+        auto report = [&](const char *name, auto &&operation)
+        {
+            result.reset();
+            const uint64_t t0 = realtime_now();
+            const unsigned result_size = operation();
+            const uint64_t t1 = realtime_now();
+            printf("|a| = %u, |b| = %u, %-30s %.1f ms, result = %u\n", a_number, b_number, name,
+                   (t1 - t0)/1e6, result_size);
+        };
+        report("member loop intersect", [&]()
+        {
+            a.for_each([&](common::int_holder &holder)
+            {
+                common::int_holder c = holder;
+                if (b.member(c))
+                    result.insert(c);
+            });
+            return result.size();
+        });
+        report("std::set_intersection (sorted)", [&]()
+        {
+            std::vector<int> out;
+            std::set_intersection(a_keys.begin(), a_keys.end(), b_keys.begin(), b_keys.end(), std::back_inserter(out));
+            return static_cast<unsigned>(out.size());
+        });
+        report("intersect, 1 thread", [&]() { a.intersect(b, result, 1); return result.size(); });
+        char name[32];
+        snprintf(name, sizeof(name), "intersect, %u threads", threads);
+        report(name, [&]() { a.intersect(b, result, threads); return result.size(); });
+        report("member loop difference", [&]()
+        {
+            a.for_each([&](common::int_holder &holder)
+            {
+                common::int_holder c = holder;
+                if (!b.member(c))
+                    result.insert(c);
+            });
+            return result.size();
+        });
+        report("difference", [&]() { a.difference(b, result, threads); return result.size(); });
+        report("unite", [&]() { a.unite(b, result, threads); return result.size(); });
+    }
+    printf("OK :)\n");
+}
+
+static void benchmark__aggregation()
+{
+    using table_type = common::AggregationHashmap<2000003>;
+    static table_type aggregated;
+    static common::Hashmap<2000003, common::uint32_holder> distinct;
+    constexpr unsigned items_number = 1000000;
+    constexpr unsigned events_number = 10000000;
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+    printf("\n%s\n\n", __FUNCTION__);
+    srand(time(nullptr));
+    for (double theta : {0.5, 0.99})
+    {
+        workload::zipf_generator zipf(items_number, theta);
+        std::vector<uint32_t> events(events_number);
+        for (auto &key : events)
+            key = static_cast<uint32_t>(static_cast<uint64_t>(zipf.next())*654435761u%1000000000);
+
+        auto report = [&](const char *name, auto &&count)
+        {
+            const uint64_t t0 = realtime_now();
+            const unsigned keys = count();
+            const uint64_t t1 = realtime_now();
+            printf("theta = %.2f, %-26s %.2f ns/event, %u keys\n", theta, name, (t1 - t0)*1.0/events_number, keys);
+        };
+        report("std::unordered_map ++", [&]()
+        {
+            std::unordered_map<uint32_t, uint32_t> counters;
+            for (auto key : events)
+                counters[key]++;
+            return static_cast<unsigned>(counters.size());
+        });
+        report("member + insert (no count)", [&]()
+        {
+            distinct.reset();
+            common::uint32_holder c;
+            c.mark = false;
+            for (auto key : events)
+            {
+                c.content = key;
+                c.occupied = true;
+                if (!distinct.member(c))
+                    distinct.insert(c);
+            }
+            return distinct.size();
+        });
+        report("upsert", [&]()
+        {
+            aggregated.reset();
+            for (auto key : events)
+                aggregated.upsert(key);
+            return aggregated.size();
+        });
+        report("aggregate", [&]()
+        {
+            aggregated.reset();
+            aggregated.aggregate(events.data(), events.size());
+            return aggregated.size();
+        });
+        char name[48];
+        snprintf(name, sizeof(name), "%u thread tables + merge", threads);
+        report(name, [&]()
+        {
+            std::vector<std::unique_ptr<table_type>> tables;
+            for (unsigned thread = 0; thread < threads; thread++)
+                tables.emplace_back(new table_type());
+            std::vector<std::thread> workers;
+            const unsigned chunk = (events_number + threads - 1)/threads;
+            for (unsigned thread = 0; thread < threads; thread++)
+                workers.emplace_back([&, thread]()
+                {
+                    const unsigned first = std::min(events_number, thread*chunk);
+                    tables[thread]->aggregate(events.data() + first, std::min(events_number, first + chunk) - first);
+                });
+            for (auto &worker : workers)
+                worker.join();
+            for (unsigned thread = 1; thread < threads; thread++)
+                tables[0]->merge(*tables[thread]);
+            return tables[0]->size();
+        });
+    }
+    printf("OK :)\n");
+}
+
+static void benchmark__hash_join()
+{
+    using join_type = common::HashJoin<2000003>;
+    static join_type join;
+    constexpr uint32_t build_rows = 1000000;
+    constexpr uint32_t probe_rows = 100000000;
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+    printf("\n%s\n\n", __FUNCTION__);
+    srand(time(nullptr));
+    // x -> x*654435761 mod 10^9 is injective: build keys are x < 1M, probe keys hit them with 10%,
+    // other probe keys are x from [1M, 10M) and never match
+    auto key_of = [](uint32_t x) { return static_cast<uint32_t>(uint64_t(x)*654435761u%1000000000); };
+    std::vector<uint32_t> build_keys(build_rows), probe_keys(probe_rows);
+    for (uint32_t row = 0; row < build_rows; row++)
+        build_keys[row] = key_of(row);
+    for (auto &key : probe_keys)
+        key = (rand()%10 == 0)? key_of(rand()%build_rows) : key_of(build_rows + rand()%(9*build_rows));
+    std::vector<common::join_match> out(probe_rows/8);
+
+    auto report = [&](const char *name, uint32_t rows, auto &&run)
+    {
+        const uint64_t t0 = realtime_now();
+        const size_t matches = run();
+        const uint64_t t1 = realtime_now();
+        printf("%-32s %8.1f ms, %.2f ns/row, %zu matches\n", name, (t1 - t0)/1e6, (t1 - t0)*1.0/rows, matches);
+    };
+
+    std::unordered_multimap<uint32_t, uint32_t> multimap;
+    report("unordered_multimap build", build_rows, [&]()
+    {
+        multimap.reserve(build_rows);
+        for (uint32_t row = 0; row < build_rows; row++)
+            multimap.emplace(build_keys[row], row);
+        return multimap.size();
+    });
+    report("unordered_multimap probe", probe_rows, [&]()
+    {
+        size_t matches = 0;
+        for (uint32_t row = 0; row < probe_rows; row++)
+        {
+            auto range = multimap.equal_range(probe_keys[row]);
+            for (auto it = range.first; it != range.second; ++it, matches++)
+                if (matches < out.size())
+                    out[matches] = {it->second, row};
+        }
+        return matches;
+    });
+    report("HashJoin build", build_rows, [&]()
+    {
+        join.build(build_keys.data(), build_rows);
+        return join.size();
+    });
+    report("HashJoin probe, 1 thread", probe_rows, [&]()
+    {
+        return join.probe(probe_keys.data(), probe_rows, out.data(), out.size(), 1);
+    });
+    char name[48];
+    snprintf(name, sizeof(name), "HashJoin probe, %u threads", threads);
+    report(name, probe_rows, [&]()
+    {
+        return join.probe(probe_keys.data(), probe_rows, out.data(), out.size(), threads);
+    });
+    printf("OK :)\n");
+}
+
+static void benchmark__partitioned()
+{
+    static common::Hashmap<50000021> direct;
+    static common::PartitionedHashmap<9, 100003> partitioned;
+    constexpr unsigned keys_number = 25000000;
+
+    printf("\n%s\n\n", __FUNCTION__);
+    srand(time(nullptr));
+    std::vector<int> keys(keys_number), probes(keys_number);
+    for (auto &key : keys)
+        key = rand()%1000000000;
+    // half of probes hit
+    for (unsigned k = 0; k < keys_number; k++)
+        probes[k] = (k%2 == 0)? keys[rand()%keys_number] : rand()%1000000000;
+    std::unique_ptr<bool[]> results(new bool[keys_number]);
+
+    auto report = [&](const char *name, auto &&run)
+    {
+        const uint64_t t0 = realtime_now();
+        const unsigned number = run();
+        const uint64_t t1 = realtime_now();
+        printf("%-28s %8.1f ms, %.2f ns/key, %u\n", name, (t1 - t0)/1e6, (t1 - t0)*1.0/keys_number, number);
+    };
+    report("direct insert", [&]()
+    {
+        common::int_holder c;
+        c.mark = false;
+        for (int key : keys)
+        {
+            c.content = key;
+            direct.insert(c);
+        }
+        return direct.size();
+    });
+    report("partitioned insert_bulk", [&]()
+    {
+        partitioned.insert_bulk(keys.data(), keys.size());
+        return partitioned.size();
+    });
+    report("direct member", [&]()
+    {
+        unsigned hits = 0;
+        common::int_holder c;
+        c.mark = false;
+        for (int key : probes)
+        {
+            c.content = key;
+            hits += direct.member(c);
+        }
+        return hits;
+    });
+    report("partitioned member", [&]()
+    {
+        unsigned hits = 0;
+        common::int_holder c;
+        c.mark = false;
+        for (int key : probes)
+        {
+            c.content = key;
+            hits += partitioned.member(c);
+        }
+        return hits;
+    });
+    report("partitioned member_bulk", [&]()
+    {
+        partitioned.member_bulk(probes.data(), probes.size(), results.get());
+        return static_cast<unsigned>(std::count(results.get(), results.get() + keys_number, true));
+    });
+    printf("OK :)\n");
+}
+
+/*
+ * The same setup as benchmark__only_hashmap_basic_for_member: 190000 keys in 200003 table (0.95),
+ * 1024 fixed queries (mostly misses, then half of them hits), 60M queries. Iter4_Broken_But_Fast gets
+ * copy of table (vector with padding, so it doesn't read behind it), its hits are wrong - only time counts.
+ */
+static void benchmark__bounded_probe()
+{
+    constexpr unsigned keys_number = 190000;
+    constexpr unsigned queries = 60000000;
+    static common::ExperimentalHashmap<200003> hash_map;
+    static common::BoundedHashmap<200003, 8> bounded8;
+    static common::BoundedHashmap<200003, 16> bounded16;
+
+    printf("\n%s\n\n", __FUNCTION__);
+    srand(time(nullptr));
+    hash_map.reset();
+    common::int_holder c;
+    c.mark = false;
+    std::vector<int> keys;
+    for (unsigned i = 0; i < keys_number; i++)
+    {
+        c.content = rand()%1000000000;
+        keys.push_back(c.content);
+        hash_map.insert(c);
+        bounded8.insert(c);
+        bounded16.insert(c);
+    }
+    std::vector<int> misses, hits;
+    for (unsigned i = 0; i < 1024; i++)
+    {
+        misses.push_back(rand()%1000000000);
+        hits.push_back((i%2 == 0)? keys[rand()%keys_number] : misses.back());
+    }
+    std::vector<common::int_holder> iter4_table(hash_map.table.begin(), hash_map.table.end());
+    common::int_holder empty;
+    empty.mark = false;
+    empty.init_as_empty();
+    iter4_table.resize(iter4_table.size() + 1024, empty);
+
+    for (auto *members : {&misses, &hits})
+    {
+        auto report = [&](const char *name, auto &&member)
+        {
+            unsigned found {0};
+            const uint64_t t0 = realtime_now();
+            for (unsigned i = 0; i < queries; i++)
+            {
+                c.content = (*members)[i%members->size()];
+                found += member(c);
+            }
+            const uint64_t t1 = realtime_now();
+            printf("%s, %-24s %6lu ms, %.2f ns/query, hits = %u\n", (members == &misses)? "misses" : "50% hits",
+                   name, (t1 - t0)/1000000, (t1 - t0)*1.0/queries, found);
+        };
+        report("member", [&](common::int_holder &key) { return hash_map.member(key); });
+        report("fast_member (Iter3)", [&](common::int_holder &key) { return hash_map.fast_member(key); });
+        report("Iter4_Broken_But_Fast", [&](common::int_holder &key)
+        {
+            return common::Iter4_Broken_But_Fast::process_search__true__optimized(iter4_table, key) >= 0;
+        });
+        report("BoundedHashmap<8>", [&](common::int_holder &key) { return bounded8.member(key); });
+        report("BoundedHashmap<16>", [&](common::int_holder &key) { return bounded16.member(key); });
+    }
+    printf("stash: %u keys (8), %u keys (16)\n", bounded8.stash_size(), bounded16.stash_size());
+    printf("OK :)\n");
+}
+
+// inserted keys (caller keeps at most half) topped up with random ones to 1M, shuffled
+static void shuffle_member_queries(std::vector<int> &members)
+{
+    while (members.size() < 1000000)
+        members.push_back(rand()%1000000000);
+    for (unsigned i = members.size() - 1; i > 0; i--)
+        std::swap(members[i], members[rand()%(i + 1)]);
+}
+
+struct member_timing
+{
+    double ns_per_query;
+    unsigned hits;
+};
+
+// queries calls of member(key) going round members
+template<class Member>
+static member_timing time_member(const std::vector<int> &members, unsigned queries, Member &&member)
+{
+    common::int_holder c;
+    c.mark = false;
+    unsigned hits {0};
+    const uint64_t t0 = realtime_now();
+    for (unsigned i = 0; i < queries; i++)
+    {
+        c.content = members[i%members.size()];
+        hits += member(c);
+    }
+    const uint64_t t1 = realtime_now();
+    return {(t1 - t0)*1.0/queries, hits};
+}
+
+/*
+ * Limited_quadratic_hash vs Bucketized_quadratic_hash at 0.95 load, member and fast_member (Iter3 /
+ * Iter_line - table is over 0.8 so kernel runs), queries: 1M keys, up to half of them inserted.
+ * 200003 table (1MB) stays in L2, 50000021 one (250MB) doesn't fit even L3.
+ */
+template<unsigned Size>
+static void bucketized_for_member()
+{
+    static common::ExperimentalHashmap<Size, common::Limited_quadratic_hash> quadratic;
+    static common::ExperimentalHashmap<Size, common::Bucketized_quadratic_hash> bucketized;
+    constexpr unsigned queries = 20000000;
+
+    common::int_holder c;
+    c.mark = false;
+    std::vector<int> keys;
+    while (quadratic.size() < 0.95*Size)
+    {
+        c.content = rand()%1000000000;
+        quadratic.insert(c);
+        bucketized.insert(c);
+        if (keys.size() < 500000)
+            keys.push_back(c.content);
+    }
+    std::vector<int> members(keys);
+    shuffle_member_queries(members);
+    const double quadratic_collisions = quadratic.collisions*1.0/quadratic.size();
+    const double bucketized_collisions = bucketized.collisions*1.0/bucketized.size();
+
+    auto report = [&](const char *name, auto &&member)
+    {
+        const member_timing timing = time_member(members, queries, member);
+        printf("%u, %-26s %.2f ns/query, hits = %u\n", Size, name, timing.ns_per_query, timing.hits);
+    };
+    report("quadratic member", [&](common::int_holder &key) { return quadratic.member(key); });
+    report("quadratic Iter3", [&](common::int_holder &key) { return quadratic.fast_member(key); });
+    report("bucketized member", [&](common::int_holder &key) { return bucketized.member(key); });
+    report("bucketized Iter_line", [&](common::int_holder &key)
+    {
+        return bucketized.template fast_member<common::Iter_line>(key);
+    });
+    printf("%u, collisions per insert: quadratic %.2f, bucketized %.2f\n", Size,
+           quadratic_collisions, bucketized_collisions);
+}
+
+static void benchmark__bucketized()
+{
+    printf("\n%s\n\n", __FUNCTION__);
+    srand(time(nullptr));
+    bucketized_for_member<200003>();
+    bucketized_for_member<50000021>();
+    printf("OK :)\n");
+}
+
+/*
+ * Every kernel forced vs fast_member (n > 0.8*m rule) vs adaptive_member while table fills
+ * from 0.3 to 0.95, queries: 1M keys, half of them inserted. adaptive_member runs twice, second
+ * run is the settled state (no sampling). Active kernel and its switches come from adaptive_counters.
+ */
+template<unsigned Size>
+static void adaptive_for_member()
+{
+    static common::ExperimentalHashmap<Size> hash_map;
+    constexpr unsigned queries = 10000000;
+
+    common::int_holder c;
+    c.mark = false;
+    for (double load : {0.3, 0.6, 0.8, 0.9, 0.95})
+    {
+        std::vector<int> members;
+        while (hash_map.size() < load*Size)
+        {
+            c.content = rand()%1000000000;
+            hash_map.insert(c);
+            if (members.size() < 500000)
+                members.push_back(c.content);
+        }
+        shuffle_member_queries(members);
+
+        auto report = [&](const char *name, auto &&member)
+        {
+            const member_timing timing = time_member(members, queries, member);
+            printf("%u, load %.2f, %-16s %.2f ns/query, hits = %u\n", Size, load, name, timing.ns_per_query,
+                   timing.hits);
+        };
+        auto forced = [&](common::probe_kernel kernel)
+        {
+            return [&, kernel](common::int_holder &key)
+            {
+                const int i = hash_map.probe(kernel, key);
+                return (hash_map.table[i] == key) && !hash_map.table[i].mark;
+            };
+        };
+        report("scalar", forced(common::probe_kernel::scalar));
+        report("sse (Iter3)", forced(common::probe_kernel::sse));
+        if (common::has_avx2())
+            report("avx2", forced(common::probe_kernel::avx2));
+        report("fast_member", [&](common::int_holder &key) { return hash_map.fast_member(key); });
+        report("adaptive_member", [&](common::int_holder &key) { return hash_map.adaptive_member(key); });
+        // same queries again - table didn't change, so sampling has stopped by now
+        report("adaptive, again", [&](common::int_holder &key) { return hash_map.adaptive_member(key); });
+        const common::kernel_counters counters = hash_map.adaptive_counters();
+        printf("%u, load %.2f, active = %s, switches = %u, epochs = %u, settled = %d, scalar probes per sample = %.2f\n",
+               Size, load, common::kernel_name(counters.active), counters.switches, counters.epochs, counters.settled,
+               counters.scalar_probes*1.0/counters.samples[0]);
+    }
+}
+
+static void benchmark__adaptive()
+{
+    printf("\n%s\n\n", __FUNCTION__);
+    srand(time(nullptr));
+    adaptive_for_member<200003>();
+    adaptive_for_member<50000021>();
+    printf("OK :)\n");
+}
+
 }
 
 int main()
@@ -453,5 +1216,15 @@ int main()
     benchmarks::test_intrinsics3();
 
     benchmarks::benchmark__only_hashmap_basic_for_member();
+    benchmarks::benchmark__key_holders_for_member();
+    benchmarks::benchmark__scan();
+    benchmarks::benchmark__erase_if();
+    benchmarks::benchmark__set_algebra();
+    benchmarks::benchmark__aggregation();
+    benchmarks::benchmark__hash_join();
+    benchmarks::benchmark__partitioned();
+    benchmarks::benchmark__bounded_probe();
+    benchmarks::benchmark__bucketized();
+    benchmarks::benchmark__adaptive();
     return 0;
 }
@@ -8,11 +8,20 @@
 #include <cstdlib>
 #include <vector>
 #include <map>
+#include <set>
 #include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
+#include <memory>
+#include <unistd.h>
+#include <malloc.h>
+#include <thread>
 #include <cmath>
+#include <string>
 
-#include "hashmap.hpp"
+#include "sstring.hpp"
+#include "intern_pool.hpp"
+#include "latency.hpp"
 
 /*
   Motivation:
@@ -102,9 +111,145 @@
 
       Speedup ~17%-19%.
 
+  * iteration 9:
+    - sstring<7> is one uint64_t (7 chars + size/tag byte), so sstring_holder hashes and compares
+      the whole word: hash = high 32 bits of word*2^64/phi + multiply-shift to [0, m), == is one cmp.
+      Default ctor zeroes buffer (otherwise garbage after string breaks flat compare), move of
+      internal string doesn't touch source, empty slot is internal word {INF, 0, .., tag}.
+
+      Time (25M inserts, 50000021 hashmap):
+            inserts = 25000000, members = 0, hits = 0, size/capacity = 0.500000
+            hashmap.collisions = 131079040, colisions per insert = 1, avg find time = 9ns
+            Time = 945 ms.      (was 17ns, 1796 ms)
+
+            inserts = 25000000, members = 0, hits = 100000000, size/capacity = 0.500000
+            hashmap.collisions = 10871963, colisions per insert = 0, avg find time = 5ns
+            Time = 534 ms.      (was 20ns, 2055 ms)
+
+      Loop over 1024 fixed keys is mostly hash + compare, so that's where the win is. Sampled find
+      latency (1M random keys, cache misses) is within noise between runs.
+
+  * iteration 10:
+    - external strings can be moved: move steals heap buffer (noexcept, no allocation), source becomes
+      empty internal, move assignment frees old buffer of destination. Default ctor is empty internal
+      also for MaxSize > 7. Size prefix of external buffer is whole uint32_t (was only low byte).
+    - operator== compares external strings by size + memcmp, basic_sstring_holder<MaxSize> hashes them
+      8 chars at a time. sstring_holder = basic_sstring_holder<7>, small path is unchanged.
+    - long_keys_perf, keys prepared before timing and moved by insert (1M keys to 2000003, 2M to 4000037):
+
+            long keys = 24 B, inserts = 1000000, size/capacity = 0.499999, colisions per insert = 0.43
+            hashmap: avg insert time = 184ns, avg find time = 223ns, hits = 10000000
+            unordered_map<string>: avg insert time = 612ns, avg find time = 210ns, hits = 10000000
+            long keys = 64 B, inserts = 2000000, size/capacity = 0.499995, colisions per insert = 0.43
+            hashmap: avg insert time = 266ns, avg find time = 312ns, hits = 10000000
+            unordered_map<string>: avg insert time = 912ns, avg find time = 346ns, hits = 10000000
+
+      Inserts are 3x faster (no node allocation, buffer is stolen), finds are the same - both pay
+      cache miss for key on heap.
+
+  * iteration 11:
+    - sstring<MaxSize, Alloc> - external buffers come from allocation policy. new_allocator is old new[]/delete[],
+      arena_allocator<Tag> cuts them from 1MB chunks, deallocate is no-op. Hashmap::reset calls
+      Holder::release_storage (when holder has it) so arena is rewound in O(1) and chunks are reused.
+    - allocator_perf, 2M keys of 25B into 4000037 hashmap, sstring built from raw chars inside timed loop:
+
+            new[] round 0: inserts = 2000000, avg insert time = 383ns, heap = +92 MB, rss = +92 MB, reset = 208 ms
+            new[] round 1: inserts = 2000000, avg insert time = 548ns, heap = +92 MB, rss = +92 MB, reset = 265 ms
+            arena round 0: inserts = 2000000, avg insert time = 330ns, heap = +62 MB, rss = +0 MB, reset = 11 ms
+            arena round 1: inserts = 2000000, avg insert time = 308ns, heap = +62 MB, rss = +0 MB, reset = 10 ms
+
+      (arena rss = +0 because it runs on pages freed by new[] run, heap column is what counts)
+      ~1/3 less memory (no malloc header, 32B instead of 48B per key), 15-45% faster inserts, reset
+      doesn't free 2M buffers one by one (what's left of it is loop over slots). Numbers are noisy here.
+
+  * iteration 12:
+    - runtime length ctor sstring(const char*, size) / sstring(std::string_view) - up to 7 bytes inline
+      (built in one word), longer ones external, bytes are copied once straight to final storage.
+      Needs C++17 for string_view (Makefiles: -std=c++17), sstring converts back to string_view too.
+    - ingest_perf, 2M length prefixed records of 1..7 bytes from one buffer into 4000037 hashmap:
+
+            ingest records = 2000000, hashmap: avg time = 219ns, size = 1426693
+            ingest records = 2000000, unordered_map<string>: avg time = 650ns, size = 1426693
+
+  * iteration 13:
+    - sstring16 - 16B, 15 chars inline, size/tag in byte 15 (second word, so external is just
+      {pointer, size, tag = 0}). == is pcmpeqb + pmovmskb, hash of internal one is 64x64->128 multiply
+      folded. SString16Hashmap = sstring16_holder (24B slot, 8B sstring_holder slot is 16B).
+    - key_length_perf, 2M keys: 20% 1..7, 60% 8..15, 20% 16..32 chars, 4000037 hashmap, 10M finds:
+
+            sstring<32> (8B)       avg insert time = 311ns, avg find time = 288ns, table = 61 MB, keys on heap = 53 MB
+            sstring16 (16B)        avg insert time = 371ns, avg find time = 116ns, table = 91 MB, keys on heap = 16 MB
+            unordered_map<string>  avg insert time = 1069ns, avg find time = 357ns, all on heap = 212 MB
+
+      Finds are 2.5x faster (80% of keys never leave the table, no pointer chase), inserts are a bit
+      slower - table is 1.5x bigger so more cache misses while probing. Memory is ~the same.
+
+  * iteration 14:
+    - heterogeneous lookup: Hashmap::member/find(key) for any key with Holder::lookup(key), sstring holders
+      take std::string_view (and Hashmap::member(const char*, size)). lookup() turns view into inline
+      word(s) once, then hash/equals work on them - no holder, no allocation per query.
+    - load_bytes - up to 8 bytes into word by 2 overlapping 4B loads instead of variable length memcpy
+      call, runtime ctors use it too.
+    - lookup_perf, 2M realistic keys in table, queries over 1024 of them (avg find time):
+
+            sstring<32> (8B)   holder find: 53ns    string_view find: 32ns
+            sstring16 (16B)    holder find: 46ns    string_view find: 16ns
+            unordered_map      std::string find: 42ns
+
+  * iteration 15:
+    - interning::intern_pool (intern_pool.hpp) - string <-> dense uint32_t id on top of
+      basic_sstring_holder + arena, hit path lock-free (seqlock validated probe), misses under mutex.
+    - intern_perf, 10M labels from 100k distinct (skewed, realistic lengths), avg intern time:
+
+            intern_pool                          178ns
+            unordered_map<string, uint32_t>      395ns
+
+  * iteration 16:
+    - long keys: slot of basic_sstring_holder<MaxSize > 7> keeps fingerprint (32-bit hash_bytes, set when
+      holder is hashed), == and equals() compare it before touching buffer on heap. It fits in
+      padding after mark, slot stays 16B. Compare itself is equal_bytes (16B pcmpeqb
+      chunks, overlapping tail), external sstring compares size prefix + chars in one go.
+    - long_miss_perf, 24B keys, 2000003 table, 10M misses (avg miss time):
+
+            size/capacity = 0.85, colisions per miss = 7    holder: 886ns -> 380ns   string_view: 986ns -> 395ns
+            size/capacity = 0.95, colisions per miss = 23.7 holder: 3022ns -> 841ns  string_view: 2777ns -> 858ns
+            unordered_set<string>                          ~300-390ns
+
+      Every collision was a cache miss on heap, now it's only slot line. unordered_set is still
+      faster for misses in such full table: its chain is ~1 node, quadratic probe here is 7-24 lines.
+
+  * iteration 17:
+    - batch::hash_sse2/hash_avx2 - hash_word + reduce of 2/4 short keys per step, bit exact with scalar
+      (64-bit multiply built from pmuludq). AVX2 one has target attribute and is picked at runtime
+      (__builtin_cpu_supports), so Makefiles stay at -msse4.2.
+    - Hashmap::member_batch - hashes group of 16 keys (Holder::hash_batch when holder has it) and
+      prefetches their slots while previous group is probed.
+    - batch_hash_perf, 4096 hot keys (hashes/ns), then 1M queries on 4000037 table (avg find time):
+
+            scalar 0.71 hashes/ns    sse2 0.70 hashes/ns    avx2 1.45 hashes/ns
+            member 36-45ns           member_batch 41-55ns
+
+      AVX2 is 2x, SSE2 gains nothing (3 pmuludq for 2 keys vs 2 imul). member_batch doesn't pay off
+      here: hash is ~1.5ns of ~14ns find even in cache, and out of order core already overlaps misses
+      of independent member() calls - prefetch only adds work (1 CPU VM, might differ on metal).
+
+  * iteration 18:
+    - ExperimentalSStringHashmap::fast_member - SIMD probe for short keys above 0.8 load (like
+      ExperimentalHashmap + Iter3): 4 quadratic probes gathered, compared with key and empty_word by
+      pcmpeqq (Probe64_sse41, 2 lanes) or vpcmpeqq (Probe64_avx2, 4 lanes, picked at runtime).
+    - 1900000 random keys in 2000003 table (0.95), 1024 absent keys, ~24 probes per miss:
+
+            SStringHashmap_perf present=false:  member 211-245ns, fast_member 211-217ns
+            20M queries loop:  member 265ns, Probe64_sse41 207ns, Probe64_avx2 203ns
+            ./benchmark --key=sstring --load-factors=0.9 --hit-ratio=0 (keys all over table):
+                               sstring_hashmap_quadratic 892 ns/op, experimental_sstring_hashmap 757 ns/op
+
+      ~20% less on misses in full table - 4 loads are in flight at once and one branch per 4 probes
+      instead of 2 per probe. Below 0.8 chains are short and scalar search is used.
+
   - TO DO: After all run on arm!
 
-  TO DO1: should I use malloc instead new? (Like in sstring.hh?) Any overhead?
+  TO DO1: should I use malloc instead new? (Like in sstring.hh?) Any overhead? -> arena, see iteration 11
   TO DO2: test for 4GB sstring ?
   TO DO3: some variadic helpers?
   TO DO4: hashing?
@@ -112,141 +257,6 @@
 namespace sstrings
 {
 
-template<const unsigned MaxSize>
-class sstring final
-{
-public:
-    using value_type = char;
-    using reference = char&;
-    using size_type = unsigned;
-
-    sstring(const sstring &) = delete;
-    sstring& operator=(const sstring &) = delete;
-    sstring& operator=(const sstring &&) = delete;
-
-    sstring()
-    {
-        constexpr auto internal {(MaxSize <= 7)};
-        init_content<internal>();
-    }
-
-    sstring(const char (&input_cstring)[MaxSize])
-    {
-        constexpr auto internal {(MaxSize <= 7)};
-        init_content<internal>(input_cstring);
-    }
-
-    // now it works only for internal strings
-    sstring& operator=(sstring &&another) noexcept
-    {
-        content = another.content;
-        another.init_content<true>();
-        return *this;
-    }
-
-    // now it works only for internal strings
-    sstring(sstring&& another) noexcept
-    {
-        content = another.content;
-        another.init_content<true>();
-    }
-
-    char& operator[](unsigned pos) {
-        return content.internal.buffer[pos];
-    }
-
-    bool is_internal() const
-    {
-        return (content.internal.size & 0x10);
-    }
-
-    // that's flat comparision and works only for internal (small) strings
-    bool operator==(const sstring& another) const
-    {
-        return content.internal_for_cmp.value ==
-                another.content.internal_for_cmp.value;
-    }
-
-    ~sstring()
-    {
-        if (!is_internal())
-            delete[] content.external.buffer;
-    }
-
-private:
-    union contents
-    {
-        struct internal_type
-        {
-            char buffer[7]; //0-55
-            char size; //56-63, but size is 0..7 (4bits) so bits 56,57,58,59 are used and bit 60 is unused
-            // from the other side from https://www.kernel.org/doc/Documentation/vm/pagemap.txt
-            // in linux 64bit virtual address bits 57-60 zero are ALWAYS zero.
-            // So finally I may use bit 60! It means I may use bit(4) in size ()
-            // Bit(60) == 0 => external
-            // Bit(60) == 1 => internal!
-        } internal;
-        struct internal_type_for_cmp
-        {
-            uint64_t value;
-        } internal_for_cmp;
-        struct external_type
-        {
-            char *buffer;
-        } external;
-        static_assert(sizeof(internal_type) == 8 && sizeof(external_type) == 8, "storage too big");
-    } content;
-    static_assert(sizeof(content) == 8, "storage is fucked up");
-
-    template<bool T>
-    struct is_internal_helper { constexpr static bool value = T; };
-
-    template<bool T>
-    void init_content(const char (&input_cstring)[MaxSize])
-    {
-        init_content(input_cstring, is_internal_helper<T>());
-    }
-
-    template<bool T>
-    void init_content()
-    {
-        init_content(is_internal_helper<T>());
-    }
-
-    void init_content(is_internal_helper<true>)
-    {
-        static_assert(MaxSize <= 7, "input string is too big");
-        content.internal.size = 0x10;
-    }
-
-    void init_content(is_internal_helper<false>)
-    {
-        static_assert(MaxSize > 7, "input string is too small");
-
-        unsigned size {MaxSize};
-        content.external.buffer = new char[MaxSize + 4];
-        content.external.buffer[0] = *reinterpret_cast<char*>(&size);
-    }
-
-    void init_content(const char (&input_cstring)[MaxSize], is_internal_helper<true>)
-    {
-        static_assert(MaxSize <= 7, "input string is too big");
-        std::memcpy(content.internal.buffer, input_cstring, MaxSize);
-        content.internal.size = (MaxSize & 0xf) | 0x10;
-    }
-
-    void init_content(const char (&input_cstring)[MaxSize], is_internal_helper<false>)
-    {
-        static_assert(MaxSize > 7, "input string is too small");
-
-        content.external.buffer = new char[MaxSize + 4];
-        std::memcpy(content.external.buffer + 4, input_cstring, MaxSize);
-
-        unsigned size {MaxSize};
-        content.external.buffer[0] = *reinterpret_cast<char*>(&size);
-    }
-};
-
 static void test_case()
 {
     {
@@ -300,6 +310,276 @@ static void test_case()
         assert(!str2.is_internal());
     }
 
+    {
+        char buf[] {"foo"};
+        sstring<sizeof buf> str1 {buf};
+        sstring<7> str2;
+        str2[0] = 'f';
+        str2[1] = 'o';
+        str2[2] = 'o';
+        // unused chars are zero in both, but size byte differs
+        assert((str1.word() & 0x00ffffffffffffffULL) == (str2.word() & 0x00ffffffffffffffULL));
+        assert(str1.word() != str2.word());
+
+        sstring<7> str3(std::move(str2));
+        assert(str3 == str2);
+    }
+
+    {
+        char buf[] {"foo894hfnsdjknfsbar"};
+        sstring<sizeof buf> str1 {buf};
+        const char *heap = str1.data();
+        assert(str1.size() == sizeof buf && str1[3] == '8');
+
+        // move steals buffer, source is empty internal
+        sstring<sizeof buf> str2(std::move(str1));
+        assert(str2.data() == heap && str1.is_internal() && str1.size() == 0);
+
+        // move assignment frees old buffer of destination (ASan in debug build checks it)
+        sstring<sizeof buf> str3 {buf};
+        assert(str3 == str2 && str3.data() != heap);
+        str3 = std::move(str2);
+        assert(str3.data() == heap && str2.is_internal());
+        str3 = std::move(str3);
+        assert(str3.data() == heap);
+
+        char buf2[] {"foo894hfnsdjknfsbaz"};
+        sstring<sizeof buf2> str4 {buf2};
+        assert(!(str3 == str4) && !(str3 == str2));
+    }
+
+    {
+        const char packet[] {"abcfoo894hfnsdjknfsbar"};
+        sstring<32> small(packet, 3);
+        sstring<32> big(packet + 3, 19);
+        assert(small.is_internal() && small.size() == 3 && std::string_view(small) == "abc");
+        assert(!big.is_internal() && big.size() == 19 && std::string_view(big) == "foo894hfnsdjknfsbar");
+
+        sstring<32> big2(std::string_view("foo894hfnsdjknfsbar"));
+        assert(big == big2);
+        // external strings of different size, longer one must not be read past shorter buffer
+        sstring<32> longer("abcdefghijk", 11);
+        sstring<32> shorter("abcdefgh", 8);
+        assert(!(longer == shorter) && !(shorter == longer));
+        sstring<7> seven(std::string_view("abc"));
+        assert(seven.word() == small.word());
+
+        bool thrown {false};
+        try
+        {
+            sstring<7> too_long(packet, 8);
+        }
+        catch (const std::length_error &)
+        {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+
+    {
+        sstring16<> sku(std::string_view("SKU-0012345678"));
+        sstring16<> sku2("SKU-0012345678", 14);
+        sstring16<> host(std::string_view("db-17.eu-west.example.com"));
+        assert(sku.is_internal() && sku.size() == 14 && sku == sku2);
+        assert(!host.is_internal() && std::string_view(host) == "db-17.eu-west.example.com");
+        assert(!(sku == host) && sizeof(sku) == 16);
+
+        const char *heap = host.data();
+        sstring16<> host2(std::move(host));
+        assert(host2.data() == heap && host.is_internal() && host.size() == 0);
+        sku2 = std::move(host2);
+        assert(sku2.data() == heap && std::string_view(sku2) == "db-17.eu-west.example.com");
+    }
+
+    {
+        // heterogeneous lookup must hash/compare like holder built from the same bytes, every length
+        using holder8_type = hashing_benchmark::basic_sstring_holder<40>;
+        using holder16_type = hashing_benchmark::sstring16_holder;
+        std::unique_ptr<common::Hashmap<500, holder8_type>> hashmap8(new common::Hashmap<500, holder8_type>());
+        std::unique_ptr<common::Hashmap<500, holder16_type>> hashmap16(new common::Hashmap<500, holder16_type>());
+        const char text[] {"0123456789abcdefghijklmnopqrstuvwxyzABCD"};
+        holder8_type holder8;
+        holder16_type holder16;
+        holder8.mark = holder16.mark = false;
+        for (unsigned size = 0; size <= 40; size++)
+        {
+            holder8.content = sstring<40>(text, size);
+            hashmap8->insert(holder8);
+            holder16.content = sstring16<>(text, size);
+            hashmap16->insert(holder16);
+        }
+        for (unsigned size = 0; size <= 40; size++)
+        {
+            const std::string_view key(text, size);
+            assert(hashmap8->member(key) && hashmap16->member(key) && hashmap8->member(text, size));
+            const std::string other = std::string(key) + "!";
+            assert(size == 0 || (!hashmap8->member(std::string_view(other).substr(1)) &&
+                                  !hashmap16->member(std::string_view(other).substr(1))));
+            holder8_type query;
+            query.content = sstring<40>(text, size);
+            assert(hashmap8->member(query));
+        }
+    }
+
+    {
+        // batch hash kernels bit exact with scalar hash (odd n for tails), member_batch == member
+        using namespace hashing_benchmark;
+        std::vector<sstring_holder> keys(37);
+        std::unique_ptr<SStringHashmap<500>> hashmap(new SStringHashmap<500>());
+        for (unsigned i = 0; i < keys.size(); i++)
+        {
+            char buf[7];
+            for (auto &c : buf)
+                c = 1 + rand()%127;
+            keys[i].mark = false;
+            keys[i].content = sstring<7>(buf, i%8);
+            if (i%2)
+            {
+                sstring_holder copy;
+                copy.mark = false;
+                copy.content = sstring<7>(std::string_view(keys[i].content));
+                hashmap->insert(copy);
+            }
+        }
+        int scalar[37], sse2[37], avx2[37];
+        for (unsigned i = 0; i < keys.size(); i++)
+            scalar[i] = sstring_holder::hash(keys[i], 500);
+        batch::hash_sse2(keys.data(), keys.size(), 500, sse2);
+        assert(std::equal(scalar, scalar + keys.size(), sse2));
+        if (batch::has_avx2())
+        {
+            batch::hash_avx2(keys.data(), keys.size(), 500, avx2);
+            assert(std::equal(scalar, scalar + keys.size(), avx2));
+        }
+        bool results[37];
+        hashmap->member_batch(keys.data(), keys.size(), results);
+        for (unsigned i = 0; i < keys.size(); i++)
+            assert(results[i] == hashmap->member(keys[i]));
+
+        std::unique_ptr<common::Hashmap<500>> int_hashmap(new common::Hashmap<500>());
+        common::int_holder ints[3] {{7, false}, {8, false}, {507, false}};
+        int_hashmap->insert(ints[0]);
+        int_hashmap->member_batch(ints, 3, results);
+        assert(results[0] && !results[1] && !results[2]);
+    }
+
+    {
+        // SIMD probes == scalar search in full table with tombstones, for hits and misses
+        using namespace hashing_benchmark;
+        std::unique_ptr<ExperimentalSStringHashmap<500>> hashmap(new ExperimentalSStringHashmap<500>());
+        std::vector<sstring_holder> keys(600);
+        for (unsigned i = 0; i < keys.size(); i++)
+        {
+            char buf[7];
+            for (auto &c : buf)
+                c = 1 + rand()%127;
+            keys[i].mark = false;
+            keys[i].content = sstring<7>(buf, 1 + i%7);
+            if (i < 450)
+            {
+                sstring_holder copy;
+                copy.mark = false;
+                copy.content = sstring<7>(std::string_view(keys[i].content));
+                hashmap->insert(copy);
+            }
+        }
+        for (unsigned i = 0; i < 450; i += 10)
+            hashmap->erase(keys[i]);
+        for (auto &key : keys)
+        {
+            const bool expected = hashmap->member(key);
+            assert(hashmap->fast_member<Probe64_sse41>(key) == expected);
+            if (batch::has_avx2())
+                assert(hashmap->fast_member<Probe64_avx2>(key) == expected);
+            assert(hashmap->fast_member(key) == expected);
+        }
+    }
+
+    {
+        // iteration skips empty slots and tombstones (live_mask of sstring holder)
+        using namespace hashing_benchmark;
+        std::unique_ptr<SStringHashmap<500>> hashmap(new SStringHashmap<500>());
+        assert(hashmap->begin() == hashmap->end());
+        std::set<std::string> expected;
+        for (unsigned i = 0; i < 300; i++)
+        {
+            const std::string key = std::to_string(i*7919);
+            sstring_holder holder;
+            holder.mark = false;
+            holder.content = sstring<7>(key.data(), key.size());
+            hashmap->insert(holder);
+            if (i%3)
+                expected.insert(key);
+            else
+            {
+                holder.content = sstring<7>(key.data(), key.size());
+                hashmap->erase(holder);
+            }
+        }
+        std::set<std::string> iterated, visited;
+        for (auto &holder : *hashmap)
+            iterated.insert(std::string(std::string_view(holder.content)));
+        hashmap->for_each([&](sstring_holder &holder)
+        {
+            visited.insert(std::string(std::string_view(holder.content)));
+        });
+        assert(iterated == expected && visited == expected);
+    }
+
+    {
+        // equal_bytes vs memcmp: every size, one different byte at every position
+        char a[48], b[48];
+        for (unsigned i = 0; i < sizeof a; i++)
+            a[i] = b[i] = 'a' + i%26;
+        for (unsigned size = 0; size <= 40; size++)
+        {
+            assert(equal_bytes(a, b, size));
+            for (unsigned i = 0; i < size; i++)
+            {
+                b[i] ^= 1;
+                assert(!equal_bytes(a, b, size) && equal_bytes(a, b, i));
+                b[i] ^= 1;
+            }
+        }
+    }
+
+    {
+        struct test_arena {};
+        using arena = arena_allocator<test_arena>;
+        using holder_type = hashing_benchmark::basic_sstring_holder<10, arena>;
+        std::unique_ptr<common::Hashmap<500, holder_type>> hashmap(new common::Hashmap<500, holder_type>());
+
+        char buf[] {"foobarbaz"};
+        holder_type holder;
+        holder.mark = false;
+        holder.content = sstring<sizeof buf, arena>(buf);
+        const char *first = holder.content.data();
+        hashmap->insert(holder);
+        holder.content = sstring<sizeof buf, arena>(buf);
+        assert(hashmap->member(holder) && hashmap->size() == 1);
+
+        // rewound arena gives the same memory again
+        hashmap->reset();
+        assert(!hashmap->member(holder));
+        holder.content = sstring<sizeof buf, arena>(buf);
+        assert(holder.content.data() == first && arena::reserved() == arena::chunk_size);
+
+        // second table would rewind strings of the first on reset
+        bool thrown = false;
+        try
+        {
+            std::unique_ptr<common::Hashmap<500, holder_type>> other(new common::Hashmap<500, holder_type>());
+        }
+        catch (const std::logic_error &)
+        {
+            thrown = true;
+        }
+        assert(thrown);
+        hashmap.reset();
+        hashmap.reset(new common::Hashmap<500, holder_type>());
+        arena::free_chunks();
+    }
+
     {
         std::array<sstring<7>, 123> strings;
         sstring<7> c;
@@ -311,6 +591,81 @@ static void test_case()
 
 }
 
+namespace interning
+{
+
+static void test_case()
+{
+    using pool_type = intern_pool<100003>;
+    std::unique_ptr<pool_type> pool(new pool_type());
+
+    const uint32_t foo = pool->intern("foo");
+    const uint32_t host = pool->intern("db-17.eu-west.example.com");
+    assert(foo == 0 && host == 1 && pool->intern(std::string("foo")) == foo);
+    assert(pool->str(host) == "db-17.eu-west.example.com" && pool->str(foo) == "foo");
+    assert(pool->find("bar") == pool_type::not_found && pool->size() == 2);
+
+    // writer adds new strings while reader interns already known ones (hit path, no lock)
+    std::vector<std::string> known, fresh;
+    for (unsigned i = 0; i < 20000; i++)
+    {
+        known.push_back("label_" + std::to_string(i));
+        fresh.push_back("metric.name." + std::to_string(i));
+    }
+    std::vector<uint32_t> known_ids;
+    for (auto &label : known)
+        known_ids.push_back(pool->intern(label));
+
+    std::atomic<bool> done {false};
+    std::atomic<unsigned> mismatches {0};
+    std::thread reader([&]()
+    {
+        for (unsigned round = 0; !done.load(); round++)
+            for (unsigned i = 0; i < known.size(); i += 7)
+                if (pool->intern(known[i]) != known_ids[i] || pool->str(known_ids[i]) != known[i])
+                    mismatches++;
+    });
+    // strings being interned right now - id seen by find has to resolve in str
+    std::thread fresh_reader([&]()
+    {
+        while (!done.load())
+            for (unsigned i = 0; i < fresh.size(); i += 3)
+            {
+                const uint32_t id = pool->find(fresh[i]);
+                if (id != pool_type::not_found && pool->str(id) != fresh[i])
+                    mismatches++;
+            }
+    });
+    for (auto &name : fresh)
+        pool->intern(name);
+    done = true;
+    reader.join();
+    fresh_reader.join();
+
+    assert(mismatches == 0 && pool->size() == 2 + known.size() + fresh.size());
+    for (unsigned i = 0; i < fresh.size(); i++)
+        assert(pool->str(pool->find(fresh[i])) == fresh[i]);
+
+    // pool frees arena of its Tag, so second one with the same Tag can't live next to it
+    struct other_tag {};
+    bool thrown = false;
+    try
+    {
+        pool_type second;
+    }
+    catch (const std::logic_error &)
+    {
+        thrown = true;
+    }
+    std::unique_ptr<intern_pool<100003, other_tag>> other(new intern_pool<100003, other_tag>());
+    assert(thrown && other->intern("db-17.eu-west.example.com") == 0);
+    assert(pool->str(host) == "db-17.eu-west.example.com");
+
+    printf("%s ok\n", __PRETTY_FUNCTION__);
+}
+
+}
+
 namespace specialization_proof_of_concept
 {
 
@@ -359,60 +714,14 @@ static void test_case()
 namespace hashing_benchmark
 {
 
-constexpr int INF {-1};
-
-struct sstring_holder final
-{
-    sstrings::sstring<7> content;
-    bool mark;
-
-    void init_as_empty()
-    {
-        content[0] = INF;
-    }
-
-    bool is_empty()
-    {
-        return content[0] == INF;
-    }
-
-	bool operator==(sstring_holder& holder)
-	{
-		for (int i = 0; i < 7; i++)
-		if (content[i] != holder.content[i])
-			return false;
-		return true;
-	}
-//	bool operator==(const sstring_holder& cp) const
-//	{
-//		return content == cp.content;
-//	}
-    static int hash(sstring_holder& holder, int m)
-    {
-        int result = 0;
-        int mul = 1;
-        for (int i = 0; i < 7; i++)
-        {
-            result = result + (holder.content[i]*mul);
-            mul *= 10;
-        }
-        return result % m;
-    }
-} __attribute__((packed));
-
-
-template<unsigned Size>
-using SStringHashmap = common::Hashmap<Size,
-                                       sstring_holder,
-                                       common::Limited_quadratic_hash>;
-
+// Size > 7 gives external string, so it has to be built from array, not by operator[]
 template<unsigned Size>
 static sstrings::sstring<Size> rand_sstring()
 {
-    sstrings::sstring<Size> result;
+    char buf[Size];
     for (unsigned i = 0; i < Size; i++)
-        result[i] = rand()%128;
-    return result;
+        buf[i] = rand()%128;
+    return sstrings::sstring<Size>(buf);
 }
 
 static std::string rand_string(unsigned max_size)
@@ -582,10 +891,10 @@ static void sstring_benchmark__only_stl_unordered_map()
 template<unsigned Size>
 static sstring_holder rand_sstring_in_holder()
 {
-    sstring_holder basic_sstring_holder;
-    basic_sstring_holder.mark = false;
-    basic_sstring_holder.content = rand_sstring<Size>();
-    return basic_sstring_holder;
+    sstring_holder holder;
+    holder.mark = false;
+    holder.content = rand_sstring<Size>();
+    return holder;
 }
 
 template<class Map, class Key>
@@ -602,6 +911,12 @@ static inline bool adapted_find(std::unordered_map<std::string, std::string> &ha
     return hashmap.find(key) != hashmap.end();
 }
 
+template<unsigned Size>
+static inline bool adapted_find(ExperimentalSStringHashmap<Size> &hashmap, sstring_holder &key)
+{
+    return hashmap.fast_member(key);
+}
+
 template<class Map, class Key>
 static inline void adapted_insert(Map &hashmap, Key &key);
 
@@ -651,11 +966,17 @@ static void SStringHashmap_perf(Hashmap &hash_map,
         printf("Inserting strings to hashmap and queries preprocessing\n");
     srand(time(nullptr));
 
+    const latency::timer &timer = latency::default_timer();
+    latency::histogram insert_latency;
+
     std::vector<key_type> members;
     for (unsigned i = 0; i < inserts; i++)
     {
         auto holder = generator();
+        const uint64_t ticks0 = timer.start();
         adapted_insert(hash_map, holder);
+        const uint64_t ticks1 = timer.stop();
+        insert_latency.record(timer.to_ns(ticks1 - ticks0));
         inserts_counter++;
         if (present && (i < fixed_members))
             members.emplace_back(std::move(holder));
@@ -688,8 +1009,526 @@ static void SStringHashmap_perf(Hashmap &hash_map,
            inserts_counter, members_counter, members_hits, hash_map.size()*1.0f/hash_map.bucket_count());
     stats(hash_map, inserts_counter, queries, time_ms);
     printf("Time = %lu ms.\n", time_ms);
+
+    constexpr unsigned latency_samples = 1000000;
+    unsigned latency_hits = 0;
+    auto find_latency = latency::sample(latency_samples, [&](unsigned i){
+        latency_hits += adapted_find(hash_map, members[i%fixed_members]);
+    });
+    insert_latency.print("insert");
+    find_latency.print("find");
 }
 
+/*
+ * Long keys (KeySize > 7, on heap). Keys are generated before timing, insert moves them into table:
+ * Hashmap::insert steals sstring buffer, std::string key is moved too, so no allocation
+ * in timed inserts of hashmap (unordered_map still allocates node).
+ * Finds use second copy of keys.
+ */
+template<unsigned Size, unsigned KeySize>
+static void long_keys_perf(unsigned inserts)
+{
+    using holder_type = basic_sstring_holder<KeySize>;
+    using Hashmap = common::Hashmap<Size, holder_type, common::Limited_quadratic_hash>;
+    constexpr unsigned queries = 10000000;
+
+    std::unique_ptr<Hashmap> hash_map(new Hashmap());
+    std::unordered_map<std::string, std::string> stl_hash_map;
+
+    srand(time(nullptr));
+    std::vector<holder_type> keys(inserts), finds(inserts);
+    std::vector<std::string> stl_keys, stl_finds;
+    stl_keys.reserve(inserts);
+    stl_finds.reserve(inserts);
+    for (unsigned i = 0; i < inserts; i++)
+    {
+        char buf[KeySize];
+        for (unsigned j = 0; j < KeySize; j++)
+            buf[j] = rand()%128;
+        keys[i].mark = finds[i].mark = false;
+        keys[i].content = sstrings::sstring<KeySize>(buf);
+        finds[i].content = sstrings::sstring<KeySize>(buf);
+        stl_keys.emplace_back(buf, KeySize);
+        stl_finds.emplace_back(buf, KeySize);
+    }
+
+    uint64_t t0 = realtime_now();
+    for (unsigned i = 0; i < inserts; i++)
+        hash_map->insert(keys[i]);
+    uint64_t t1 = realtime_now();
+    const uint64_t insert_ns = t1 - t0;
+    const unsigned insert_collisions = hash_map->collisions;
+    assert(keys[0].content.is_internal());
+
+    unsigned hits {0};
+    t0 = realtime_now();
+    for (unsigned i = 0; i < queries; i++)
+        hits += hash_map->member(finds[i%inserts]);
+    t1 = realtime_now();
+    const uint64_t find_ns = t1 - t0;
+
+    printf("long keys = %u B, inserts = %u, size/capacity = %f, colisions per insert = %.2f\n", KeySize, inserts,
+           hash_map->size()*1.0f/hash_map->capacity(), insert_collisions*1.0f/inserts);
+    printf("hashmap: avg insert time = %luns, avg find time = %luns, hits = %u\n",
+           insert_ns/inserts, find_ns/queries, hits);
+
+    t0 = realtime_now();
+    for (unsigned i = 0; i < inserts; i++)
+        stl_hash_map.emplace(std::move(stl_keys[i]), std::string());
+    t1 = realtime_now();
+    const uint64_t stl_insert_ns = t1 - t0;
+
+    unsigned stl_hits {0};
+    t0 = realtime_now();
+    for (unsigned i = 0; i < queries; i++)
+        stl_hits += (stl_hash_map.find(stl_finds[i%inserts]) != stl_hash_map.end());
+    t1 = realtime_now();
+    const uint64_t stl_find_ns = t1 - t0;
+
+    printf("unordered_map<string>: avg insert time = %luns, avg find time = %luns, hits = %u\n",
+           stl_insert_ns/inserts, stl_find_ns/queries, stl_hits);
+}
+
+/*
+ * Misses of long keys in full table - every probe of the chain lands on slot with other long key,
+ * so this is where comparing has to reject without reading buffer on heap.
+ * Queries are 1M absent keys (as holder and as string_view), 10M lookups each.
+ */
+template<unsigned Size, unsigned KeySize>
+static void long_miss_perf(double load_factor)
+{
+    using holder_type = basic_sstring_holder<KeySize>;
+    using Hashmap = common::Hashmap<Size, holder_type, common::Limited_quadratic_hash>;
+    constexpr unsigned queries = 10000000;
+    constexpr unsigned absent = 1000000;
+    const unsigned inserts = load_factor*Size;
+
+    std::unique_ptr<Hashmap> hash_map(new Hashmap());
+    std::unordered_set<std::string> stl_hash_set;
+    srand(time(nullptr));
+    auto random_key = []()
+    {
+        std::string result(KeySize, ' ');
+        for (auto &c : result)
+            c = rand()%128;
+        return result;
+    };
+    for (unsigned i = 0; i < inserts; i++)
+    {
+        const std::string key = random_key();
+        holder_type holder;
+        holder.mark = false;
+        holder.content = sstrings::sstring<KeySize>(key.data(), key.size());
+        hash_map->insert(holder);
+        stl_hash_set.insert(key);
+    }
+
+    std::vector<std::string> raw(absent);
+    std::vector<holder_type> finds(absent);
+    for (unsigned i = 0; i < absent; i++)
+    {
+        raw[i] = random_key();
+        finds[i].mark = false;
+        finds[i].content = sstrings::sstring<KeySize>(raw[i].data(), raw[i].size());
+    }
+
+    hash_map->collisions = 0;
+    unsigned hits {0};
+    uint64_t t0 = realtime_now();
+    for (unsigned i = 0; i < queries; i++)
+        hits += hash_map->member(finds[i%absent]);
+    uint64_t t1 = realtime_now();
+    const uint64_t holder_ns = t1 - t0;
+    const unsigned probes = hash_map->collisions;
+
+    t0 = realtime_now();
+    for (unsigned i = 0; i < queries; i++)
+        hits += hash_map->member(std::string_view(raw[i%absent]));
+    t1 = realtime_now();
+    const uint64_t view_ns = t1 - t0;
+
+    t0 = realtime_now();
+    for (unsigned i = 0; i < queries; i++)
+        hits += (stl_hash_set.find(raw[i%absent]) != stl_hash_set.end());
+    t1 = realtime_now();
+    const uint64_t stl_ns = t1 - t0;
+
+    printf("long key misses = %u B, size/capacity = %.2f, colisions per miss = %.2f, hits = %u\n", KeySize,
+           hash_map->size()*1.0f/hash_map->capacity(), probes*1.0f/queries, hits);
+    printf("hashmap: holder miss = %luns, string_view miss = %luns, unordered_set<string> miss = %luns\n",
+           holder_ns/queries, view_ns/queries, stl_ns/queries);
+}
+static long rss_mb()
+{
+    long pages {0}, resident {0};
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm)
+    {
+        if (fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+            resident = 0;
+        fclose(statm);
+    }
+    return resident*sysconf(_SC_PAGESIZE)/(1024*1024);
+}
+
+// malloc'ed and mmaped by malloc, RSS alone hides memory reused from earlier benchmarks
+static long heap_mb()
+{
+    const struct mallinfo2 info = mallinfo2();
+    return (info.uordblks + info.hblkhd)/(1024*1024);
+}
+
+struct long_keys_arena {};
+
+/*
+ * Insert throughput with key allocation inside timed loop (sstring from raw chars + insert) and
+ * RSS growth, global allocator vs arena. Two rounds with reset between them: second round of arena
+ * reuses chunks.
+ */
+template<unsigned Size, unsigned KeySize, class Alloc>
+static void allocator_perf(const char *name, const std::vector<char> &raw, unsigned inserts)
+{
+    using holder_type = basic_sstring_holder<KeySize, Alloc>;
+    using Hashmap = common::Hashmap<Size, holder_type, common::Limited_quadratic_hash>;
+
+    std::unique_ptr<Hashmap> hash_map(new Hashmap());
+    const long rss0 = rss_mb();
+    const long heap0 = heap_mb();
+
+    for (unsigned round = 0; round < 2; round++)
+    {
+        holder_type holder;
+        holder.mark = false;
+        uint64_t t0 = realtime_now();
+        for (unsigned i = 0; i < inserts; i++)
+        {
+            holder.content = sstrings::sstring<KeySize, Alloc>(
+                        reinterpret_cast<const char (&)[KeySize]>(raw[i*KeySize]));
+            hash_map->insert(holder);
+        }
+        uint64_t t1 = realtime_now();
+        const uint64_t insert_ns = t1 - t0;
+        const long rss1 = rss_mb();
+        const long heap1 = heap_mb();
+
+        t0 = realtime_now();
+        hash_map->reset();
+        t1 = realtime_now();
+        printf("%s round %u: inserts = %u, avg insert time = %luns, heap = +%ld MB, rss = +%ld MB, "
+               "reset = %lu ms\n", name, round, inserts, insert_ns/inserts, heap1 - heap0, rss1 - rss0,
+               (t1 - t0)/1000000);
+    }
+}
+
+template<unsigned Size, unsigned KeySize>
+static void allocator_perf(unsigned inserts)
+{
+    srand(time(nullptr));
+    std::vector<char> raw(inserts*KeySize);
+    for (auto &c : raw)
+        c = rand()%128;
+
+    allocator_perf<Size, KeySize, sstrings::new_allocator>("new[]", raw, inserts);
+    allocator_perf<Size, KeySize, sstrings::arena_allocator<long_keys_arena>>("arena", raw, inserts);
+    printf("arena reserved = %zu MB\n", sstrings::arena_allocator<long_keys_arena>::reserved()/(1024*1024));
+    sstrings::arena_allocator<long_keys_arena>::free_chunks();
+}
+/*
+ * Ingest path: length prefixed records in one buffer (like network packet), keys of 1..7 bytes
+ * built with runtime length ctor straight from buffer.
+ */
+template<unsigned Size>
+static void ingest_perf(unsigned records)
+{
+    srand(time(nullptr));
+    std::vector<char> packet;
+    packet.reserve(records*8);
+    for (unsigned i = 0; i < records; i++)
+    {
+        const unsigned size = 1 + rand()%7;
+        packet.push_back(size);
+        for (unsigned j = 0; j < size; j++)
+            packet.push_back(rand()%128);
+    }
+
+    std::unique_ptr<SStringHashmap<Size>> hash_map(new SStringHashmap<Size>());
+    std::unordered_map<std::string, std::string> stl_hash_map;
+
+    sstring_holder holder;
+    holder.mark = false;
+    uint64_t t0 = realtime_now();
+    for (size_t pos = 0; pos < packet.size(); pos += 1 + packet[pos])
+    {
+        holder.content = sstrings::sstring<7>(&packet[pos + 1], packet[pos]);
+        hash_map->insert(holder);
+    }
+    uint64_t t1 = realtime_now();
+    printf("ingest records = %u, hashmap: avg time = %luns, size = %u\n", records, (t1 - t0)/records,
+           hash_map->size());
+
+    t0 = realtime_now();
+    for (size_t pos = 0; pos < packet.size(); pos += 1 + packet[pos])
+        stl_hash_map.emplace(std::string(&packet[pos + 1], packet[pos]), std::string());
+    t1 = realtime_now();
+    printf("ingest records = %u, unordered_map<string>: avg time = %luns, size = %zu\n", records,
+           (t1 - t0)/records, stl_hash_map.size());
+}
+/*
+ * Key lengths like in our data: 20% 1..7 (codes), 60% 8..15 (SKUs, UUID prefixes, hostnames),
+ * 20% 16..32. The same keys go to sstring<32> (8B, inline up to 7), sstring16 (16B, inline up to 15)
+ * and std::string (SSO up to 15 but 32B + node).
+ */
+static std::vector<std::string> realistic_keys(unsigned keys_number)
+{
+    std::vector<std::string> keys;
+    keys.reserve(keys_number);
+    for (unsigned i = 0; i < keys_number; i++)
+    {
+        const unsigned dice = rand()%10;
+        const unsigned size = (dice < 2)? 1 + rand()%7 : (dice < 8)? 8 + rand()%8 : 16 + rand()%17;
+        std::string key(size, ' ');
+        for (auto &c : key)
+            c = rand()%128;
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+template<class Hashmap, class String>
+static void key_length_perf(const char *name, const std::vector<std::string> &raw)
+{
+    using holder_type = typename Hashmap::key_type;
+    constexpr unsigned queries = 10000000;
+    const unsigned inserts = raw.size();
+
+    std::unique_ptr<Hashmap> hash_map(new Hashmap());
+    std::vector<holder_type> finds(inserts);
+    for (unsigned i = 0; i < inserts; i++)
+    {
+        finds[i].mark = false;
+        finds[i].content = String(raw[i]);
+    }
+
+    const long heap0 = heap_mb();
+    holder_type holder;
+    holder.mark = false;
+    uint64_t t0 = realtime_now();
+    for (unsigned i = 0; i < inserts; i++)
+    {
+        holder.content = String(raw[i]);
+        hash_map->insert(holder);
+    }
+    uint64_t t1 = realtime_now();
+    const uint64_t insert_ns = t1 - t0;
+    const long heap1 = heap_mb();
+
+    unsigned hits {0};
+    t0 = realtime_now();
+    for (unsigned i = 0; i < queries; i++)
+        hits += hash_map->member(finds[i%inserts]);
+    t1 = realtime_now();
+    printf("%-22s avg insert time = %luns, avg find time = %luns, hits = %u, size = %u, "
+           "table = %lu MB, keys on heap = %ld MB\n", name, insert_ns/inserts, (t1 - t0)/queries, hits,
+           hash_map->size(), sizeof(*hash_map)/(1024*1024), heap1 - heap0);
+}
+
+template<unsigned Size>
+static void key_length_perf(unsigned keys_number)
+{
+    constexpr unsigned queries = 10000000;
+    srand(time(nullptr));
+    const auto raw = realistic_keys(keys_number);
+
+    key_length_perf<common::Hashmap<Size, basic_sstring_holder<32>>, sstrings::sstring<32>>("sstring<32> (8B)", raw);
+    key_length_perf<SString16Hashmap<Size>, sstrings::sstring16<>>("sstring16 (16B)", raw);
+
+    std::unordered_map<std::string, std::string> stl_hash_map;
+    const long heap0 = heap_mb();
+    uint64_t t0 = realtime_now();
+    for (auto &key : raw)
+        stl_hash_map.emplace(key, std::string());
+    uint64_t t1 = realtime_now();
+    const uint64_t insert_ns = t1 - t0;
+    const long heap1 = heap_mb();
+
+    unsigned hits {0};
+    t0 = realtime_now();
+    for (unsigned i = 0; i < queries; i++)
+        hits += (stl_hash_map.find(raw[i%keys_number]) != stl_hash_map.end());
+    t1 = realtime_now();
+    printf("%-22s avg insert time = %luns, avg find time = %luns, hits = %u, size = %zu, "
+           "all on heap = %ld MB\n", "unordered_map<string>", insert_ns/keys_number, (t1 - t0)/queries, hits,
+           stl_hash_map.size(), heap1 - heap0);
+}
+/*
+ * Read path: key arrives as string_view. Old way builds holder (allocation for keys > 7 chars),
+ * heterogeneous find hashes and compares the view directly.
+ */
+template<class Hashmap, class String>
+static void lookup_perf(const char *name, const std::vector<std::string> &raw)
+{
+    using holder_type = typename Hashmap::key_type;
+    constexpr unsigned queries = 10000000;
+    constexpr unsigned fixed_members = 1024;
+
+    std::unique_ptr<Hashmap> hash_map(new Hashmap());
+    holder_type holder;
+    holder.mark = false;
+    for (auto &key : raw)
+    {
+        holder.content = String(key);
+        hash_map->insert(holder);
+    }
+
+    unsigned hits {0};
+    uint64_t t0 = realtime_now();
+    for (unsigned i = 0; i < queries; i++)
+    {
+        holder.content = String(raw[i%fixed_members]);
+        hits += adapted_find(*hash_map, holder);
+    }
+    uint64_t t1 = realtime_now();
+    printf("%-18s holder find: avg find time = %luns, hits = %u\n", name, (t1 - t0)/queries, hits);
+
+    hits = 0;
+    t0 = realtime_now();
+    for (unsigned i = 0; i < queries; i++)
+    {
+        std::string_view key(raw[i%fixed_members]);
+        hits += adapted_find(*hash_map, key);
+    }
+    t1 = realtime_now();
+    printf("%-18s string_view find: avg find time = %luns, hits = %u\n", name, (t1 - t0)/queries, hits);
+}
+
+template<unsigned Size>
+static void lookup_perf(unsigned keys_number)
+{
+    constexpr unsigned queries = 10000000;
+    constexpr unsigned fixed_members = 1024;
+    srand(time(nullptr));
+    const auto raw = realistic_keys(keys_number);
+
+    lookup_perf<common::Hashmap<Size, basic_sstring_holder<32>>, sstrings::sstring<32>>("sstring<32> (8B)", raw);
+    lookup_perf<SString16Hashmap<Size>, sstrings::sstring16<>>("sstring16 (16B)", raw);
+
+    std::unordered_map<std::string, std::string> stl_hash_map;
+    for (auto &key : raw)
+        stl_hash_map.emplace(key, std::string());
+    unsigned hits {0};
+    uint64_t t0 = realtime_now();
+    for (unsigned i = 0; i < queries; i++)
+        hits += adapted_find(stl_hash_map, raw[i%fixed_members]);
+    uint64_t t1 = realtime_now();
+    printf("%-18s std::string find: avg find time = %luns, hits = %u\n", "unordered_map", (t1 - t0)/queries,
+           hits);
+}
+/*
+ * Hashing of batch of short keys: scalar sstring_holder::hash vs batch::hash_sse2/hash_avx2
+ * (hashes/ns), then member vs member_batch on 4000037 table
+ * holding half of keys + as many others, queries half hits.
+ */
+static void batch_hash_perf(unsigned keys_number)
+{
+    constexpr unsigned rounds = 20;
+    constexpr unsigned hot_keys = 4096;
+    constexpr unsigned hot_rounds = 10000;
+    constexpr int m = 4000037;
+    srand(time(nullptr));
+    std::vector<sstring_holder> keys(keys_number);
+    for (auto &key : keys)
+        key = rand_sstring_in_holder<7>();
+    std::vector<int> hashes(keys_number);
+
+    // hot_keys (64KB) hashed over and over, so it's hash itself, not memory bandwidth
+    auto report = [&](const char *name, auto &&kernel)
+    {
+        uint64_t checksum {0};
+        const uint64_t t0 = realtime_now();
+        for (unsigned round = 0; round < hot_rounds; round++)
+        {
+            kernel();
+            checksum += hashes[round%hot_keys];
+        }
+        const uint64_t t1 = realtime_now();
+        printf("%-12s hashes = %u, %.2f hashes/ns, checksum = %lu\n", name, hot_rounds*hot_keys,
+               hot_rounds*hot_keys*1.0/(t1 - t0), checksum);
+    };
+    report("scalar", [&]()
+    {
+        for (unsigned i = 0; i < hot_keys; i++)
+            hashes[i] = sstring_holder::hash(keys[i], m);
+    });
+    report("batch sse2", [&]() { batch::hash_sse2(keys.data(), hot_keys, m, hashes.data()); });
+    if (batch::has_avx2())
+        report("batch avx2", [&]() { batch::hash_avx2(keys.data(), hot_keys, m, hashes.data()); });
+
+    std::unique_ptr<SStringHashmap<m>> hash_map(new SStringHashmap<m>());
+    for (unsigned i = 0; i < keys_number; i += 2)
+    {
+        sstring_holder copy;
+        copy.mark = false;
+        copy.content = sstrings::sstring<7>(std::string_view(keys[i].content));
+        hash_map->insert(copy);
+        sstring_holder other = rand_sstring_in_holder<7>();
+        hash_map->insert(other);
+    }
+    unsigned hits {0};
+    uint64_t t0 = realtime_now();
+    for (unsigned round = 0; round < rounds; round++)
+        for (unsigned i = 0; i < keys_number; i++)
+            hits += hash_map->member(keys[i]);
+    uint64_t t1 = realtime_now();
+    printf("member:       avg find time = %luns, hits = %u\n", (t1 - t0)/(rounds*keys_number), hits);
+
+    std::unique_ptr<bool[]> results(new bool[keys_number]);
+    hits = 0;
+    t0 = realtime_now();
+    for (unsigned round = 0; round < rounds; round++)
+    {
+        hash_map->member_batch(keys.data(), keys_number, results.get());
+        hits += std::count(results.get(), results.get() + keys_number, true);
+    }
+    t1 = realtime_now();
+    printf("member_batch: avg find time = %luns, hits = %u\n", (t1 - t0)/(rounds*keys_number), hits);
+}
+
+/*
+ * Ingest of repeated labels: 10M strings from 100k distinct ones (realistic lengths), skewed so
+ * few are very hot, given as views into one buffer. unordered_map needs std::string for find
+ * (no heterogeneous lookup in C++17).
+ */
+static void intern_perf(unsigned distinct, unsigned records)
+{
+    srand(time(nullptr));
+    const auto labels = realistic_keys(distinct);
+    std::vector<std::string_view> stream;
+    stream.reserve(records);
+    for (unsigned i = 0; i < records; i++)
+    {
+        const double r = rand()/(RAND_MAX + 1.0);
+        stream.push_back(labels[static_cast<unsigned>(r*r*r*distinct)]);
+    }
+
+    using pool_type = interning::intern_pool<200003>;
+    std::unique_ptr<pool_type> pool(new pool_type());
+    uint64_t checksum {0};
+    uint64_t t0 = realtime_now();
+    for (auto &label : stream)
+        checksum += pool->intern(label);
+    uint64_t t1 = realtime_now();
+    printf("intern_pool: records = %u, distinct = %u, avg intern time = %luns, checksum = %lu\n", records,
+           pool->size(), (t1 - t0)/records, checksum);
+
+    std::unordered_map<std::string, uint32_t> stl_pool;
+    checksum = 0;
+    t0 = realtime_now();
+    for (auto &label : stream)
+        checksum += stl_pool.emplace(std::string(label), stl_pool.size()).first->second;
+    t1 = realtime_now();
+    printf("unordered_map<string, uint32_t>: records = %u, distinct = %zu, avg intern time = %luns, "
+           "checksum = %lu\n", records, stl_pool.size(), (t1 - t0)/records, checksum);
+}
 
 }
 
@@ -697,10 +1536,25 @@ int main()
 {
 //    specialization_proof_of_concept::test_case();
     sstrings::test_case();
+    interning::test_case();
+
+    // first, so RSS isn't hidden by memory freed in other benchmarks
+    hashing_benchmark::allocator_perf<4000037, 25>(2000000);
+    hashing_benchmark::long_keys_perf<2000003, 24>(1000000);
+    hashing_benchmark::long_keys_perf<4000037, 64>(2000000);
+    hashing_benchmark::ingest_perf<4000037>(2000000);
+    hashing_benchmark::key_length_perf<4000037>(2000000);
+    hashing_benchmark::lookup_perf<4000037>(2000000);
+    hashing_benchmark::intern_perf(100000, 10000000);
+    hashing_benchmark::long_miss_perf<2000003,24>(0.85);
+    hashing_benchmark::long_miss_perf<2000003,24>(0.95);
+    hashing_benchmark::batch_hash_perf(1000000);
+    printf("\n");
 
     using hashing_benchmark::SStringHashmap_perf;
 
     using Hashmap2M = hashing_benchmark::SStringHashmap<2000003>;
+    using ExperimentalHashmap2M = hashing_benchmark::ExperimentalSStringHashmap<2000003>;
     using Hashmap4M = hashing_benchmark::SStringHashmap<4000037>;
     using Hashmap10M = hashing_benchmark::SStringHashmap<10000019>;
     using Hashmap = hashing_benchmark::SStringHashmap<50000021>;
@@ -729,6 +1583,7 @@ int main()
     static Hashmap my_hash_map;
     static StlHashMap stl_hash_map;
     static Hashmap2M hash_map2m;
+    static ExperimentalHashmap2M experimental_hash_map2m;
     static Hashmap4M hash_map4m;
     static Hashmap10M hash_map10m;
 
@@ -756,6 +1611,11 @@ int main()
     SStringHashmap_perf<StlHashMap>(stl_hash_map, stl_generator, stl_stats, 1600000);
     printf("\n");
 
+    // fast_member uses SIMD probe above 0.8 load
+    SStringHashmap_perf<Hashmap2M>(hash_map2m, my_generator, my_stats, 1900000);
+    SStringHashmap_perf<ExperimentalHashmap2M>(experimental_hash_map2m, my_generator, my_stats, 1900000);
+    printf("\n");
+
     SStringHashmap_perf<Hashmap4M>(hash_map4m, my_generator, my_stats, 2000000);
     SStringHashmap_perf<StlHashMap>(stl_hash_map, stl_generator, stl_stats, 2000000);
     printf("\n");
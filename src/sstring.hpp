@@ -0,0 +1,1087 @@
+#ifndef SSTRING_HPP
+#define SSTRING_HPP
+
+#include <cassert>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <immintrin.h>
+
+#include "hashmap.hpp"
+
+/*
+ * sstring - string with 8B footprint. Small strings (up to 7 chars) are stored inline,
+ * big ones on heap. Design notes and benchmarks history are in sstring.cpp.
+ */
+namespace sstrings
+{
+
+/*
+ * Up to 8 bytes to word (first byte lowest, rest zero) without variable length memcpy call:
+ * two overlapping loads for 4..8 bytes, three single bytes for 1..3.
+ */
+static inline uint64_t load_bytes(const char *input, unsigned size)
+{
+    if (size >= 4)
+    {
+        uint32_t low, high;
+        std::memcpy(&low, input, sizeof low);
+        std::memcpy(&high, input + size - 4, sizeof high);
+        return low | (static_cast<uint64_t>(high) << (8*(size - 4)));
+    }
+    if (size == 0)
+        return 0;
+    const uint64_t first = static_cast<uint8_t>(input[0]);
+    const uint64_t middle = static_cast<uint8_t>(input[size/2]);
+    const uint64_t last = static_cast<uint8_t>(input[size - 1]);
+    return first | (middle << (8*(size/2))) | (last << (8*(size - 1)));
+}
+
+/*
+ * memcmp(a, b, size) == 0 for keys without call and byte loop: 16B chunks by pcmpeqb + pmovmskb,
+ * the last chunk overlaps previous one, under 16B two overlapping 8B loads or load_bytes.
+ */
+static inline bool equal_bytes(const char *a, const char *b, size_t size)
+{
+    if (size >= 16)
+    {
+        for (size_t i = 0; i + 16 < size; i += 16)
+        {
+            const __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                                              _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+            if (_mm_movemask_epi8(eq) != 0xffff)
+                return false;
+        }
+        const __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + size - 16)),
+                                          _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + size - 16)));
+        return _mm_movemask_epi8(eq) == 0xffff;
+    }
+    if (size >= 8)
+    {
+        uint64_t a0, a1, b0, b1;
+        std::memcpy(&a0, a, sizeof a0);
+        std::memcpy(&b0, b, sizeof b0);
+        std::memcpy(&a1, a + size - 8, sizeof a1);
+        std::memcpy(&b1, b + size - 8, sizeof b1);
+        return ((a0 ^ b0) | (a1 ^ b1)) == 0;
+    }
+    return load_bytes(a, size) == load_bytes(b, size);
+}
+
+/*
+ * Allocation policies for external buffers: allocate(n), deallocate(buffer), release_storage(),
+ * claim(table)/unclaim(table) - called by Hashmap constructor/destructor.
+ */
+struct new_allocator final
+{
+    static char* allocate(unsigned n)
+    {
+        return new char[n];
+    }
+
+    static void deallocate(char *buffer)
+    {
+        delete[] buffer;
+    }
+
+    static void release_storage() {}
+
+    static void claim(const void *) {}
+
+    static void unclaim(const void *) {}
+};
+
+/*
+ * Bump arena, one per Tag (static state - one arena for one hashmap is the idea).
+ * - buffers are cut from 1MB chunks (bigger requests get own chunk), no per string malloc
+ * - deallocate does nothing, memory of erased/overwritten strings comes back only with release_storage,
+ *   so insert/erase churn grows the arena until reset
+ * - only one table may use arena of a Tag at a time (Hashmap constructor claims it, throws
+ *   std::logic_error otherwise) - reset of one table would rewind strings of the other
+ * - release_storage rewinds arena to first chunk in O(1), chunks are kept for next fill (RSS stays),
+ *   free_chunks gives memory back to system
+ * - strings allocated before release_storage mustn't be used after it. Not thread safe.
+ */
+template<class Tag>
+class arena_allocator final
+{
+public:
+    static constexpr unsigned chunk_size {1u << 20};
+
+    static char* allocate(unsigned n)
+    {
+        n = (n + 7) & ~7u;
+        arena &a = instance();
+        if (a.offset + n > a.current_size())
+            next_chunk(a, n);
+        char *result = a.chunks[a.current].first + a.offset;
+        a.offset += n;
+        return result;
+    }
+
+    static void deallocate(char *) {}
+
+    static void release_storage()
+    {
+        arena &a = instance();
+        a.current = 0;
+        a.offset = 0;
+    }
+
+    static void claim(const void *table)
+    {
+        arena &a = instance();
+        if (a.owner && a.owner != table)
+            throw std::logic_error("arena of this Tag is used by another table, use distinct Tag");
+        a.owner = table;
+    }
+
+    static void unclaim(const void *table)
+    {
+        arena &a = instance();
+        if (a.owner == table)
+            a.owner = nullptr;
+    }
+
+    static void free_chunks()
+    {
+        arena &a = instance();
+        for (auto &chunk : a.chunks)
+            std::free(chunk.first);
+        a.chunks.clear();
+        a.current = 0;
+        a.offset = 0;
+    }
+
+    static size_t reserved()
+    {
+        size_t result = 0;
+        for (auto &chunk : instance().chunks)
+            result += chunk.second;
+        return result;
+    }
+
+private:
+    struct arena
+    {
+        std::vector<std::pair<char*, unsigned>> chunks;
+        unsigned current {0};
+        unsigned offset {0};
+        const void *owner {nullptr};
+
+        unsigned current_size() const
+        {
+            return chunks.empty()? 0 : chunks[current].second;
+        }
+
+        ~arena()
+        {
+            for (auto &chunk : chunks)
+                std::free(chunk.first);
+        }
+    };
+
+    static arena& instance()
+    {
+        static arena a;
+        return a;
+    }
+
+    // reuses kept chunks after release_storage, too small ones are skipped
+    static void next_chunk(arena &a, unsigned n)
+    {
+        a.offset = 0;
+        if (!a.chunks.empty())
+            a.current++;
+        while (a.current < a.chunks.size() && a.chunks[a.current].second < n)
+            a.current++;
+        if (a.current < a.chunks.size())
+            return;
+        const unsigned size = (n > chunk_size)? n : chunk_size;
+        char *chunk = static_cast<char*>(std::malloc(size));
+        if (!chunk)
+            throw std::bad_alloc();
+        a.chunks.push_back({chunk, size});
+        a.current = a.chunks.size() - 1;
+    }
+};
+
+template<const unsigned MaxSize, class Alloc = new_allocator>
+class sstring final
+{
+public:
+    using value_type = char;
+    using reference = char&;
+    using size_type = unsigned;
+
+    sstring(const sstring &) = delete;
+    sstring& operator=(const sstring &) = delete;
+    sstring& operator=(const sstring &&) = delete;
+
+    // empty internal string, nothing allocated even for MaxSize > 7 (hashmap has millions of them)
+    sstring()
+    {
+        init_empty();
+    }
+
+    sstring(const char (&input_cstring)[MaxSize])
+    {
+        constexpr auto internal {(MaxSize <= 7)};
+        init_content<internal>(input_cstring);
+    }
+
+    /*
+     * Runtime length (keys from network buffers etc.), exactly size bytes are stored, no terminator.
+     * Up to 7 bytes go inline, longer ones to external buffer - the same split as compile time
+     * ctor, so operator== still holds. Bytes are copied once, straight into final storage.
+     * size > MaxSize throws std::length_error.
+     */
+    sstring(const char *input, size_type size)
+    {
+        init_content(input, size);
+    }
+
+    explicit sstring(std::string_view input)
+    {
+        if (input.size() > MaxSize)
+            throw std::length_error("sstring: input longer than MaxSize");
+        init_content(input.data(), static_cast<size_type>(input.size()));
+    }
+
+    operator std::string_view() const
+    {
+        return std::string_view(data(), size());
+    }
+
+    /*
+     * Moves never allocate: external buffer is stolen and source becomes empty internal string,
+     * internal source stays as it was (nothing is owned, benchmarks still search for keys
+     * moved into hashmap). Move assignment frees own external buffer first.
+     */
+    sstring& operator=(sstring &&another) noexcept
+    {
+        if (this == &another)
+            return *this;
+        if (!is_internal())
+            Alloc::deallocate(content.external.buffer);
+        content = another.content;
+        if (!another.is_internal())
+            another.init_empty();
+        return *this;
+    }
+
+    sstring(sstring&& another) noexcept
+    {
+        content = another.content;
+        if (!another.is_internal())
+            another.init_empty();
+    }
+
+    char& operator[](unsigned pos) {
+        return data()[pos];
+    }
+
+    const char& operator[](unsigned pos) const {
+        return data()[pos];
+    }
+
+    char* data()
+    {
+        return is_internal()? content.internal.buffer : content.external.buffer + 4;
+    }
+
+    const char* data() const
+    {
+        return is_internal()? content.internal.buffer : content.external.buffer + 4;
+    }
+
+    size_type size() const
+    {
+        if (is_internal())
+            return content.internal.size & 0xf;
+        uint32_t result;
+        std::memcpy(&result, content.external.buffer, sizeof result);
+        return result;
+    }
+
+    bool is_internal() const
+    {
+        return (MaxSize <= 7) || (content.internal.size & 0x10);
+    }
+
+    /*
+     * Strings up to 7 chars are always internal, longer ones always external, so
+     * internal vs external is never equal. Two internal strings are one flat comparision.
+     * External ones check sizes first (equal_bytes reads the tail of both ranges), then compare
+     * size prefix and chars as one range.
+     */
+    bool operator==(const sstring& another) const
+    {
+        if (content.internal_for_cmp.value == another.content.internal_for_cmp.value)
+            return true;
+        if (is_internal() || another.is_internal())
+            return false;
+        const size_type n = size();
+        return (n == another.size()) &&
+                equal_bytes(content.external.buffer, another.content.external.buffer, n + 4);
+    }
+
+    // whole internal string with size byte (tag) as one word, for hashing and flat comparisions.
+    // set_word is for internal strings only, external buffer would leak.
+    uint64_t word() const
+    {
+        return content.internal_for_cmp.value;
+    }
+
+    void set_word(uint64_t value)
+    {
+        content.internal_for_cmp.value = value;
+    }
+
+    // word() of internal string with these bytes (size <= 7), for lookups without sstring
+    static uint64_t inline_word(std::string_view input)
+    {
+        return load_bytes(input.data(), input.size()) | (static_cast<uint64_t>(input.size() | 0x10) << 56);
+    }
+
+    ~sstring()
+    {
+        if (!is_internal())
+            Alloc::deallocate(content.external.buffer);
+    }
+
+private:
+    union contents
+    {
+        struct internal_type
+        {
+            char buffer[7]; //0-55
+            char size; //56-63, but size is 0..7 (4bits) so bits 56,57,58,59 are used and bit 60 is unused
+            // from the other side from https://www.kernel.org/doc/Documentation/vm/pagemap.txt
+            // in linux 64bit virtual address bits 57-60 zero are ALWAYS zero.
+            // So finally I may use bit 60! It means I may use bit(4) in size ()
+            // Bit(60) == 0 => external
+            // Bit(60) == 1 => internal!
+        } internal;
+        struct internal_type_for_cmp
+        {
+            uint64_t value;
+        } internal_for_cmp;
+        struct external_type
+        {
+            char *buffer;
+        } external;
+        static_assert(sizeof(internal_type) == 8 && sizeof(external_type) == 8, "storage too big");
+    } content;
+    static_assert(sizeof(content) == 8, "storage is fucked up");
+
+    template<bool T>
+    struct is_internal_helper { constexpr static bool value = T; };
+
+    template<bool T>
+    void init_content(const char (&input_cstring)[MaxSize])
+    {
+        init_content(input_cstring, is_internal_helper<T>());
+    }
+
+    void init_content(const char *input, size_type size)
+    {
+        if (size > MaxSize)
+            throw std::length_error("sstring: input longer than MaxSize");
+        if (size <= 7)
+        {
+            content.internal_for_cmp.value = load_bytes(input, size);
+            content.internal.size = static_cast<char>(size | 0x10);
+            return;
+        }
+
+        content.external.buffer = Alloc::allocate(size + 4);
+        // tag bit must be clear in pointer, see comment in contents
+        assert(!(reinterpret_cast<uintptr_t>(content.external.buffer) & (1ULL << 60)));
+        std::memcpy(content.external.buffer, &size, sizeof size);
+        std::memcpy(content.external.buffer + 4, input, size);
+    }
+
+    // unused chars are zeroed, otherwise flat comparision sees garbage after string
+    void init_empty()
+    {
+        content.internal_for_cmp.value = 0;
+        content.internal.size = 0x10;
+    }
+
+    void init_content(const char (&input_cstring)[MaxSize], is_internal_helper<true>)
+    {
+        static_assert(MaxSize <= 7, "input string is too big");
+        content.internal_for_cmp.value = 0;
+        std::memcpy(content.internal.buffer, input_cstring, MaxSize);
+        content.internal.size = (MaxSize & 0xf) | 0x10;
+    }
+
+    void init_content(const char (&input_cstring)[MaxSize], is_internal_helper<false>)
+    {
+        static_assert(MaxSize > 7, "input string is too small");
+
+        content.external.buffer = Alloc::allocate(MaxSize + 4);
+        std::memcpy(content.external.buffer + 4, input_cstring, MaxSize);
+
+        // 4B size prefix, buffer from new is enough aligned but memcpy doesn't care anyway
+        const uint32_t size {MaxSize};
+        std::memcpy(content.external.buffer, &size, sizeof size);
+    }
+};
+
+/*
+ * sstring16 - 16B footprint, up to 15 chars inline (SKUs, hostnames, UUID prefixes fit), longer on heap.
+ * Byte 15 is size (bits 0-3) + tag (bit 4) like in sstring, but it's in second word so no pointer
+ * bit trick is needed: external = {buffer, size, 0 .. 0 tag byte}. Size lives inline, no prefix in buffer.
+ * Up to 15 chars always internal, longer always external, so == of internal strings is one
+ * 16B compare (pcmpeqb + pmovmskb), external ones compare size + memcmp.
+ */
+template<class Alloc = new_allocator>
+class sstring16 final
+{
+public:
+    using value_type = char;
+    using reference = char&;
+    using size_type = unsigned;
+
+    static constexpr size_type inline_capacity {15};
+
+    sstring16(const sstring16 &) = delete;
+    sstring16& operator=(const sstring16 &) = delete;
+
+    sstring16()
+    {
+        init_empty();
+    }
+
+    sstring16(const char *input, size_type size)
+    {
+        init_content(input, size);
+    }
+
+    explicit sstring16(std::string_view input)
+    {
+        init_content(input.data(), static_cast<size_type>(input.size()));
+    }
+
+    // the same as in sstring: external buffer is stolen, internal source is left as it was
+    sstring16& operator=(sstring16 &&another) noexcept
+    {
+        if (this == &another)
+            return *this;
+        if (!is_internal())
+            Alloc::deallocate(content.external.buffer);
+        content = another.content;
+        if (!another.is_internal())
+            another.init_empty();
+        return *this;
+    }
+
+    sstring16(sstring16 &&another) noexcept
+    {
+        content = another.content;
+        if (!another.is_internal())
+            another.init_empty();
+    }
+
+    ~sstring16()
+    {
+        if (!is_internal())
+            Alloc::deallocate(content.external.buffer);
+    }
+
+    bool is_internal() const
+    {
+        return content.internal.size & 0x10;
+    }
+
+    size_type size() const
+    {
+        return is_internal()? (content.internal.size & 0xf) : content.external.size;
+    }
+
+    char* data()
+    {
+        return is_internal()? content.internal.buffer : content.external.buffer;
+    }
+
+    const char* data() const
+    {
+        return is_internal()? content.internal.buffer : content.external.buffer;
+    }
+
+    char& operator[](unsigned pos) {
+        return data()[pos];
+    }
+
+    const char& operator[](unsigned pos) const {
+        return data()[pos];
+    }
+
+    operator std::string_view() const
+    {
+        return std::string_view(data(), size());
+    }
+
+    __m128i vector() const
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(&content));
+    }
+
+    uint64_t low_word() const
+    {
+        return content.words[0];
+    }
+
+    uint64_t high_word() const
+    {
+        return content.words[1];
+    }
+
+    // internal strings only, external buffer would leak
+    void set_words(uint64_t low, uint64_t high)
+    {
+        content.words[0] = low;
+        content.words[1] = high;
+    }
+
+    // low_word()/high_word() of internal string with these bytes (size <= 15)
+    static void inline_words(std::string_view input, uint64_t &low, uint64_t &high)
+    {
+        const unsigned size = input.size();
+        if (size > 8)
+        {
+            std::memcpy(&low, input.data(), sizeof low);
+            high = load_bytes(input.data() + 8, size - 8);
+        }
+        else
+        {
+            low = load_bytes(input.data(), size);
+            high = 0;
+        }
+        high |= static_cast<uint64_t>(size | 0x10) << 56;
+    }
+
+    bool operator==(const sstring16 &another) const
+    {
+        const __m128i eq = _mm_cmpeq_epi8(vector(), another.vector());
+        if (_mm_movemask_epi8(eq) == 0xffff)
+            return true;
+        if (is_internal() || another.is_internal())
+            return false;
+        const size_type n = size();
+        return (n == another.size()) && equal_bytes(data(), another.data(), n);
+    }
+
+private:
+    union contents
+    {
+        struct internal_type
+        {
+            char buffer[15];
+            char size; // bits 0-3 size, bit 4 internal tag
+        } internal;
+        struct external_type
+        {
+            char *buffer;
+            uint32_t size;
+            char unused[3]; // zeroed, so == of external strings with the same buffer works
+            char tag;       // 0
+        } external;
+        uint64_t words[2];
+        static_assert(sizeof(internal_type) == 16 && sizeof(external_type) == 16, "storage too big");
+    } content;
+    static_assert(sizeof(content) == 16, "storage is fucked up");
+
+    void init_empty()
+    {
+        content.words[0] = 0;
+        content.words[1] = 0;
+        content.internal.size = 0x10;
+    }
+
+    void init_content(const char *input, size_type size)
+    {
+        content.words[0] = 0;
+        content.words[1] = 0;
+        if (size <= inline_capacity)
+        {
+            inline_words(std::string_view(input, size), content.words[0], content.words[1]);
+            return;
+        }
+        content.external.buffer = Alloc::allocate(size);
+        content.external.size = size;
+        std::memcpy(content.external.buffer, input, size);
+    }
+};
+
+}
+
+namespace hashing_benchmark
+{
+
+constexpr int INF {-1};
+
+/*
+ * Small key is sstring<7>, so the whole key (7 chars + size byte with internal tag) is one uint64_t:
+ * hash = one multiply (high 32 bits of word*2^64/phi) + multiply-shift to [0, m),
+ * operator== = one 64-bit compare. Size byte takes part in both, so "ab" and "ab\0" differ.
+ * Empty slot is internal string with first char INF and the rest zeroed (it must stay internal,
+ * otherwise ~sstring deletes it). Like before first char INF is reserved for empty slots.
+ */
+constexpr uint64_t empty_word {static_cast<uint8_t>(INF) | (0x10ULL << 56)};
+
+static inline uint32_t hash_word(uint64_t word)
+{
+    return static_cast<uint32_t>((word*0x9e3779b97f4a7c15ULL) >> 32);
+}
+
+// long (external) keys: the same multiply, 8 chars at a time
+static inline uint32_t hash_bytes(const char *data, unsigned size)
+{
+    uint64_t result = size;
+    unsigned i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof word);
+        result = (result ^ word)*0x9e3779b97f4a7c15ULL;
+        result ^= result >> 32;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, data + i, size - i);
+    return hash_word(result ^ tail);
+}
+
+// 32-bit hash of long key kept in slot (in padding after mark, slot stays 16B)
+template<bool Long>
+struct fingerprint_field
+{
+    uint32_t value {0};
+} __attribute__((packed));
+
+template<>
+struct fingerprint_field<false> {};
+
+/*
+ * Batch of short keys (whole key = word at offset 0 of 16B slot) -> common::reduce(hash_word(word), m),
+ * bit exact with scalar hash. No 64x64 multiply in SSE2/AVX2, so high half of low 64 bits of
+ * word*K is built from 32x32->64 pmuludq:
+ *     hi32(w*K) = hi32(w_lo*K_lo) + lo32(w_hi*K_lo) + lo32(w_lo*K_hi)   (mod 2^32)
+ * and reduce is one more pmuludq by m. SSE2 does 2 keys per step, AVX2 4 (target attribute,
+ * picked at runtime by hash_batch), tail goes scalar.
+ */
+namespace batch
+{
+
+constexpr uint64_t multiplier {0x9e3779b97f4a7c15ULL};
+
+template<class Holder>
+static inline void hash_scalar(const Holder *keys, unsigned n, int m, int *hashes)
+{
+    for (unsigned i = 0; i < n; i++)
+        hashes[i] = common::reduce(hash_word(keys[i].content.word()), m);
+}
+
+template<class Holder>
+static inline void hash_sse2(const Holder *keys, unsigned n, int m, int *hashes)
+{
+    static_assert(sizeof(Holder) == 16, "word of key has to be every 16B");
+    const __m128i k_low = _mm_set1_epi64x(multiplier & 0xffffffff);
+    const __m128i k_high = _mm_set1_epi64x(multiplier >> 32);
+    const __m128i range = _mm_set1_epi64x(static_cast<uint32_t>(m));
+    unsigned i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+        const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i + 1));
+        const __m128i words = _mm_unpacklo_epi64(first, second);
+        const __m128i low = _mm_srli_epi64(_mm_mul_epu32(words, k_low), 32);
+        const __m128i cross = _mm_add_epi32(_mm_mul_epu32(_mm_srli_epi64(words, 32), k_low),
+                                            _mm_mul_epu32(words, k_high));
+        const __m128i hash = _mm_add_epi32(low, cross);
+        const __m128i slot = _mm_srli_epi64(_mm_mul_epu32(hash, range), 32);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(hashes + i), _mm_shuffle_epi32(slot, _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+    hash_scalar(keys + i, n - i, m, hashes + i);
+}
+
+template<class Holder>
+__attribute__((target("avx2")))
+static inline void hash_avx2(const Holder *keys, unsigned n, int m, int *hashes)
+{
+    static_assert(sizeof(Holder) == 16, "word of key has to be every 16B");
+    const __m256i k_low = _mm256_set1_epi64x(multiplier & 0xffffffff);
+    const __m256i k_high = _mm256_set1_epi64x(multiplier >> 32);
+    const __m256i range = _mm256_set1_epi64x(static_cast<uint32_t>(m));
+    const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    unsigned i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        // [w0 x w1 x] [w2 x w3 x] -> [w0 w2 w1 w3] -> [w0 w1 w2 w3]
+        const __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+        const __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i + 2));
+        const __m256i words = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(first, second),
+                                                       _MM_SHUFFLE(3, 1, 2, 0));
+        const __m256i low = _mm256_srli_epi64(_mm256_mul_epu32(words, k_low), 32);
+        const __m256i cross = _mm256_add_epi32(_mm256_mul_epu32(_mm256_srli_epi64(words, 32), k_low),
+                                               _mm256_mul_epu32(words, k_high));
+        const __m256i hash = _mm256_add_epi32(low, cross);
+        const __m256i slot = _mm256_srli_epi64(_mm256_mul_epu32(hash, range), 32);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(hashes + i),
+                         _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(slot, pack)));
+    }
+    hash_scalar(keys + i, n - i, m, hashes + i);
+}
+
+using common::has_avx2;
+
+template<class Holder>
+static inline void hash(const Holder *keys, unsigned n, int m, int *hashes)
+{
+    if (has_avx2())
+        hash_avx2(keys, n, m, hashes);
+    else
+        hash_sse2(keys, n, m, hashes);
+}
+
+}
+
+/*
+ * MaxSize > 7 - long keys on heap. Hashmap::insert moves holder into slot, so buffer is stolen,
+ * not copied, and tombstone overwritten by insert frees its old buffer.
+ * Slot of long key keeps fingerprint (full hash_bytes of it), so probe compares it first and reads
+ * buffer on heap only when it matches - 1 in 2^32 for other key instead of every collision.
+ * hash(holder, m) sets it (Hashmap hashes holder before any compare and before it's moved in).
+ */
+template<unsigned MaxSize, class Alloc = sstrings::new_allocator>
+struct basic_sstring_holder final
+{
+    sstrings::sstring<MaxSize, Alloc> content;
+    bool mark;
+    fingerprint_field<(MaxSize > 7)> fingerprint;
+
+    void init_as_empty()
+    {
+        if (!content.is_internal())
+            content = sstrings::sstring<MaxSize, Alloc>();
+        content.set_word(empty_word);
+    }
+
+    bool is_empty()
+    {
+        return content.word() == empty_word;
+    }
+
+    bool operator==(basic_sstring_holder& holder)
+    {
+        if constexpr (MaxSize > 7)
+        {
+            if (!content.is_internal() && (fingerprint.value != holder.fingerprint.value))
+                return false;
+        }
+        return content == holder.content;
+    }
+
+    static int hash(basic_sstring_holder& holder, int m)
+    {
+        if (holder.content.is_internal())
+            return common::reduce(hash_word(holder.content.word()), m);
+        const uint32_t result = hash_bytes(holder.content.data(), holder.content.size());
+        if constexpr (MaxSize > 7)
+            holder.fingerprint.value = result;
+        return common::reduce(result, m);
+    }
+
+    // only short keys (always internal) - Hashmap::member_batch hashes them in SIMD
+    template<unsigned M = MaxSize, class = std::enable_if_t<(M <= 7)>>
+    static void hash_batch(const basic_sstring_holder *keys, unsigned n, int m, int *hashes)
+    {
+        batch::hash(keys, n, m, hashes);
+    }
+
+    // heterogeneous lookup (Hashmap::member(std::string_view)), the same split as in sstring
+    struct lookup_key
+    {
+        std::string_view view;
+        uint64_t word; // view up to 7 chars: inline word, longer: hash_bytes (fingerprint)
+    };
+
+    static lookup_key lookup(std::string_view key)
+    {
+        if (key.size() <= 7)
+            return {key, sstrings::sstring<MaxSize, Alloc>::inline_word(key)};
+        return {key, hash_bytes(key.data(), key.size())};
+    }
+
+    static int hash(const lookup_key &key, int m)
+    {
+        if (key.view.size() <= 7)
+            return common::reduce(hash_word(key.word), m);
+        return common::reduce(static_cast<uint32_t>(key.word), m);
+    }
+
+    bool equals(const lookup_key &key) const
+    {
+        if (key.view.size() <= 7)
+            return content.word() == key.word;
+        if constexpr (MaxSize > 7)
+        {
+            return !content.is_internal() && (fingerprint.value == key.word) &&
+                    (content.size() == key.view.size()) &&
+                    sstrings::equal_bytes(content.data(), key.view.data(), key.view.size());
+        }
+        return false;
+    }
+
+    // Hashmap::reset calls it after all slots are emptied
+    static void release_storage()
+    {
+        Alloc::release_storage();
+    }
+
+    // Hashmap constructor/destructor, arena holds strings of one table only
+    static void claim_storage(const void *table)
+    {
+        Alloc::claim(table);
+    }
+
+    static void unclaim_storage(const void *table)
+    {
+        Alloc::unclaim(table);
+    }
+
+    // bit k set when slots[k] (k < 16) is live, for Hashmap iteration: word vs empty_word and mark
+    // (byte 8) of 2 slots per pcmpeqq
+    static unsigned live_mask(const basic_sstring_holder *slots)
+    {
+        static_assert(sizeof(basic_sstring_holder) == 16, "word at 0, mark at 8");
+        const __m128i empty = _mm_set1_epi64x(empty_word);
+        const __m128i mark_byte = _mm_set1_epi64x(0xff);
+        const __m128i zero = _mm_setzero_si128();
+        unsigned result = 0;
+        for (unsigned pair = 0; pair < 8; pair++)
+        {
+            const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots + 2*pair));
+            const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots + 2*pair + 1));
+            const __m128i words = _mm_unpacklo_epi64(first, second);
+            const __m128i marks = _mm_and_si128(_mm_unpackhi_epi64(first, second), mark_byte);
+            const __m128i live = _mm_andnot_si128(_mm_cmpeq_epi64(words, empty), _mm_cmpeq_epi64(marks, zero));
+            result |= _mm_movemask_pd(_mm_castsi128_pd(live)) << (2*pair);
+        }
+        return result;
+    }
+} __attribute__((packed));
+
+using sstring_holder = basic_sstring_holder<7>;
+
+template<unsigned Size>
+using SStringHashmap = common::Hashmap<Size,
+                                       sstring_holder,
+                                       common::Limited_quadratic_hash>;
+
+/*
+ * SIMD probe for short keys (like Iter3 for int_holder): whole key is one 64-bit word, so 4 quadratic
+ * probes (hc + j + j^2) are gathered and compared with key and with empty_word at once, first lane
+ * with either is the answer (tombstones keep their word, so they are skipped like in scalar search).
+ * Probe64_sse41 - 2 x pcmpeqq (2 slots per compare), Probe64_avx2 - vpcmpeqq (4 slots), target
+ * attribute, Probe64 picks one at runtime.
+ */
+template<unsigned Size>
+struct Probe64_sse41 final
+{
+    static int process_search__true__optimized(std::array<sstring_holder, Size> &table, sstring_holder &c, int hc)
+    {
+        const int m = table.size();
+        const __m128i key = _mm_set1_epi64x(c.content.word());
+        const __m128i empty = _mm_set1_epi64x(empty_word);
+        for (int j = 0;; j += 4)
+        {
+            const int v0 = (hc + j + j*j)%m;
+            const int v1 = (hc + (j + 1) + (j + 1)*(j + 1))%m;
+            const int v2 = (hc + (j + 2) + (j + 2)*(j + 2))%m;
+            const int v3 = (hc + (j + 3) + (j + 3)*(j + 3))%m;
+            const __m128i low = _mm_set_epi64x(table[v1].content.word(), table[v0].content.word());
+            const __m128i high = _mm_set_epi64x(table[v3].content.word(), table[v2].content.word());
+            const __m128i stop_low = _mm_or_si128(_mm_cmpeq_epi64(low, key), _mm_cmpeq_epi64(low, empty));
+            const __m128i stop_high = _mm_or_si128(_mm_cmpeq_epi64(high, key), _mm_cmpeq_epi64(high, empty));
+            const int stop = _mm_movemask_pd(_mm_castsi128_pd(stop_low)) |
+                             (_mm_movemask_pd(_mm_castsi128_pd(stop_high)) << 2);
+            if (stop)
+            {
+                const int lanes[4] {v0, v1, v2, v3};
+                return lanes[__builtin_ctz(stop)];
+            }
+        }
+    }
+};
+
+template<unsigned Size>
+struct Probe64_avx2 final
+{
+    __attribute__((target("avx2")))
+    static int process_search__true__optimized(std::array<sstring_holder, Size> &table, sstring_holder &c, int hc)
+    {
+        const int m = table.size();
+        const __m256i key = _mm256_set1_epi64x(c.content.word());
+        const __m256i empty = _mm256_set1_epi64x(empty_word);
+        for (int j = 0;; j += 4)
+        {
+            const int v0 = (hc + j + j*j)%m;
+            const int v1 = (hc + (j + 1) + (j + 1)*(j + 1))%m;
+            const int v2 = (hc + (j + 2) + (j + 2)*(j + 2))%m;
+            const int v3 = (hc + (j + 3) + (j + 3)*(j + 3))%m;
+            const __m256i words = _mm256_set_epi64x(table[v3].content.word(), table[v2].content.word(),
+                                                    table[v1].content.word(), table[v0].content.word());
+            const __m256i stop_lanes = _mm256_or_si256(_mm256_cmpeq_epi64(words, key),
+                                                       _mm256_cmpeq_epi64(words, empty));
+            const int stop = _mm256_movemask_pd(_mm256_castsi256_pd(stop_lanes));
+            if (stop)
+            {
+                const int lanes[4] {v0, v1, v2, v3};
+                return lanes[__builtin_ctz(stop)];
+            }
+        }
+    }
+};
+
+template<unsigned Size>
+struct Probe64 final
+{
+    static int process_search__true__optimized(std::array<sstring_holder, Size> &table, sstring_holder &c, int hc)
+    {
+        if (batch::has_avx2())
+            return Probe64_avx2<Size>::process_search__true__optimized(table, c, hc);
+        return Probe64_sse41<Size>::process_search__true__optimized(table, c, hc);
+    }
+};
+
+// SStringHashmap with fast_member, selected like in common::ExperimentalHashmap
+template<unsigned Size>
+class ExperimentalSStringHashmap final : public SStringHashmap<Size>
+{
+public:
+    using SStringHashmap<Size>::n;
+    using SStringHashmap<Size>::table;
+    using SStringHashmap<Size>::process_search__true;
+
+    template<
+            template<unsigned> class Func = Probe64
+            >
+    bool fast_member(sstring_holder &c)
+    {
+        int i = 0;
+        if (n > (4*table.size()/5))
+        {
+            i = Func<Size>::process_search__true__optimized(table, c, sstring_holder::hash(c, table.size()));
+        }
+        else
+        {
+            i = process_search__true(c);
+        }
+        return (table[i] == c) && !table[i].mark;
+    }
+};
+
+// 128-bit mix for internal sstring16: one 64x64 -> 128 multiply folded to 64 bits
+static inline uint32_t hash_words(uint64_t low, uint64_t high)
+{
+    const __uint128_t product = static_cast<__uint128_t>(low ^ 0x9e3779b97f4a7c15ULL)*
+                                (high ^ 0xc2b2ae3d27d4eb4fULL);
+    const uint64_t folded = static_cast<uint64_t>(product >> 64) ^ static_cast<uint64_t>(product);
+    return static_cast<uint32_t>(folded >> 32) ^ static_cast<uint32_t>(folded);
+}
+
+template<class Alloc = sstrings::new_allocator>
+struct basic_sstring16_holder final
+{
+    sstrings::sstring16<Alloc> content;
+    bool mark;
+
+    // like empty_word: internal, first char INF
+    void init_as_empty()
+    {
+        if (!content.is_internal())
+            content = sstrings::sstring16<Alloc>();
+        content.set_words(static_cast<uint8_t>(INF), 0x10ULL << 56);
+    }
+
+    bool is_empty()
+    {
+        return (content.low_word() == static_cast<uint8_t>(INF)) && (content.high_word() == (0x10ULL << 56));
+    }
+
+    bool operator==(basic_sstring16_holder& holder)
+    {
+        return content == holder.content;
+    }
+
+    static int hash(basic_sstring16_holder& holder, int m)
+    {
+        if (holder.content.is_internal())
+            return common::reduce(hash_words(holder.content.low_word(), holder.content.high_word()), m);
+        return common::reduce(hash_bytes(holder.content.data(), holder.content.size()), m);
+    }
+
+    struct lookup_key
+    {
+        std::string_view view;
+        uint64_t low {0}, high {0}; // valid for view up to 15 chars
+    };
+
+    static lookup_key lookup(std::string_view key)
+    {
+        lookup_key result;
+        result.view = key;
+        if (key.size() <= sstrings::sstring16<Alloc>::inline_capacity)
+            sstrings::sstring16<Alloc>::inline_words(key, result.low, result.high);
+        return result;
+    }
+
+    static int hash(const lookup_key &key, int m)
+    {
+        if (key.view.size() <= sstrings::sstring16<Alloc>::inline_capacity)
+            return common::reduce(hash_words(key.low, key.high), m);
+        return common::reduce(hash_bytes(key.view.data(), key.view.size()), m);
+    }
+
+    bool equals(const lookup_key &key) const
+    {
+        if (key.view.size() <= sstrings::sstring16<Alloc>::inline_capacity)
+            return (content.low_word() == key.low) && (content.high_word() == key.high);
+        return !content.is_internal() && (content.size() == key.view.size()) &&
+                sstrings::equal_bytes(content.data(), key.view.data(), key.view.size());
+    }
+
+    static void release_storage()
+    {
+        Alloc::release_storage();
+    }
+
+    static void claim_storage(const void *table)
+    {
+        Alloc::claim(table);
+    }
+
+    static void unclaim_storage(const void *table)
+    {
+        Alloc::unclaim(table);
+    }
+};
+
+using sstring16_holder = basic_sstring16_holder<>;
+
+template<unsigned Size>
+using SString16Hashmap = common::Hashmap<Size,
+                                         sstring16_holder,
+                                         common::Limited_quadratic_hash>;
+
+}
+
+#endif // SSTRING_HPP
@@ -0,0 +1,532 @@
+#ifndef WORKLOAD_HPP
+#define WORKLOAD_HPP
+
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <utility>
+#include <algorithm>
+
+#include "distribution.hpp"
+
+/*
+ * Workload description and reporting shared by benchmark harness.
+ *
+ * - spec is filled from command line (--name=value), see usage()
+ * - plan is precomputed stream of operations on indexes of key pool, so every table
+ *   gets exactly the same sequence of I/M/E operations and keys
+ * - key pool layout: [0, preload) keys inserted before timing,
+ *                    [preload, preload + inserts) fresh keys inserted during timing,
+ *                    [preload + inserts, size) keys which are never inserted (misses)
+ * - present keys for members/erases are chosen by distribution: uniform, zipf (theta),
+ *   hotspot (hot set fraction takes hot ops fraction) or latest (zipf over recently inserted keys).
+ *   Hottest keys have lowest indexes, pool is random so it says nothing about key values.
+ * - measurements are printed as text, csv or json. csv output may be used later as baseline
+ *   for --baseline=file compare mode.
+ */
+namespace workload
+{
+
+#define TIMESPEC_NSEC(ts) ((ts)->tv_sec * 1000000000ULL + (ts)->tv_nsec)
+
+static inline uint64_t realtime_now()
+{
+    struct timespec now_ts;
+    clock_gettime(CLOCK_REALTIME, &now_ts);
+    return TIMESPEC_NSEC(&now_ts);
+}
+
+constexpr float max_load_factor {0.95f};
+constexpr unsigned absent_keys {65536};
+
+struct spec
+{
+    std::string key {"int"};
+    std::string key_set {"random"};
+    unsigned stride {64};
+    unsigned inserts {10};
+    unsigned members {85};
+    unsigned erases {5};
+    float hit_ratio {0.5f};
+    std::string distribution {"uniform"};
+    double theta {0.99};
+    double hot_keys {0.01};
+    double hot_ops {0.6};
+    std::vector<float> load_factors {0.5f, 0.75f, 0.9f};
+    unsigned keys {0};
+    unsigned capacity {2000003};
+    unsigned operations {1000000};
+    unsigned seed {0};
+    std::string tables;
+    std::string format {"text"};
+    std::string output;
+    std::string baseline;
+    float threshold {0.1f};
+    bool counters {true};
+    unsigned latency_sample {16};
+    bool list {false};
+};
+
+static void usage(const char *name)
+{
+    printf("usage: %s [options]\n"
+           "  --key=int|sstring          key type (default int)\n"
+           "  --key-set=s                int keys: random|sequential|strided (default random)\n"
+           "  --stride=n                 distance between strided int keys, ids stay below 2^31 (default 64)\n"
+           "  --mix=I:M:E                insert/member/erase percents (default 10:85:5)\n"
+           "  --hit-ratio=h              fraction of members/erases on present keys (default 0.5)\n"
+           "  --distribution=d           uniform|zipf|hotspot|latest, present keys choice (default uniform)\n"
+           "  --theta=t                  zipf/latest skew, 0 < t < 1 (default 0.99)\n"
+           "  --hot-set=k:o              hotspot: fraction k of keys takes fraction o of ops (default 0.01:0.6)\n"
+           "  --load-factors=a,b,..      load factors before timing (default 0.5,0.75,0.9)\n"
+           "  --keys=n                   preload exactly n keys instead of load factors sweep\n"
+           "  --capacity=m               table capacity, one of supported sizes (default 2000003)\n"
+           "  --ops=n                    timed operations (default 1000000)\n"
+           "  --seed=s                   random seed, 0 = time (default 0)\n"
+           "  --tables=a,b,..            run only given tables (default all)\n"
+           "  --format=text|csv|json     output format (default text)\n"
+           "  --output=file              write results to file instead of stdout\n"
+           "  --baseline=file.csv        compare ns/op with stored csv results\n"
+           "  --threshold=t              regression threshold for compare mode (default 0.1)\n"
+           "  --counters=0|1             hardware counters per op via perf_event_open (default 1)\n"
+           "  --latency-sample=n         time every n-th op (separate pass) for latency percentiles, 0 = off (default 16)\n"
+           "  --list                     list registered tables\n", name);
+}
+
+static std::vector<std::string> split(const std::string &input, char separator)
+{
+    std::vector<std::string> result;
+    size_t begin = 0;
+    while (begin <= input.size())
+    {
+        size_t end = input.find(separator, begin);
+        if (end == std::string::npos)
+            end = input.size();
+        if (end > begin)
+            result.push_back(input.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return result;
+}
+
+static bool parse_options(int argc, char **argv, spec &config)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const size_t eq = arg.find('=');
+        const std::string name = arg.substr(0, eq);
+        const std::string value = (eq == std::string::npos)? "" : arg.substr(eq + 1);
+
+        if (name == "--key")
+            config.key = value;
+        else if (name == "--key-set")
+            config.key_set = value;
+        else if (name == "--stride")
+            config.stride = std::stoul(value);
+        else if (name == "--mix")
+        {
+            auto parts = split(value, ':');
+            if (parts.size() != 3)
+                return false;
+            config.inserts = std::stoul(parts[0]);
+            config.members = std::stoul(parts[1]);
+            config.erases = std::stoul(parts[2]);
+        }
+        else if (name == "--hit-ratio")
+            config.hit_ratio = std::stof(value);
+        else if (name == "--distribution")
+            config.distribution = value;
+        else if (name == "--theta")
+            config.theta = std::stod(value);
+        else if (name == "--hot-set")
+        {
+            auto parts = split(value, ':');
+            if (parts.size() != 2)
+                return false;
+            config.hot_keys = std::stod(parts[0]);
+            config.hot_ops = std::stod(parts[1]);
+        }
+        else if (name == "--load-factors")
+        {
+            config.load_factors.clear();
+            for (auto &part : split(value, ','))
+                config.load_factors.push_back(std::stof(part));
+        }
+        else if (name == "--keys")
+            config.keys = std::stoul(value);
+        else if (name == "--capacity")
+            config.capacity = std::stoul(value);
+        else if (name == "--ops")
+            config.operations = std::stoul(value);
+        else if (name == "--seed")
+            config.seed = std::stoul(value);
+        else if (name == "--tables")
+            config.tables = value;
+        else if (name == "--format")
+            config.format = value;
+        else if (name == "--output")
+            config.output = value;
+        else if (name == "--baseline")
+            config.baseline = value;
+        else if (name == "--threshold")
+            config.threshold = std::stof(value);
+        else if (name == "--counters")
+            config.counters = (value != "0");
+        else if (name == "--latency-sample")
+            config.latency_sample = std::stoul(value);
+        else if (name == "--list")
+            config.list = true;
+        else
+            return false;
+    }
+    return true;
+}
+
+static bool parse(int argc, char **argv, spec &config)
+{
+    // std::stoul/stod throw std::invalid_argument (--stride=x) or std::out_of_range, that's usage error too
+    try
+    {
+        if (!parse_options(argc, argv, config))
+            return false;
+    }
+    catch (const std::logic_error &)
+    {
+        return false;
+    }
+
+    if (config.inserts + config.members + config.erases != 100)
+        return false;
+    if (config.key != "int" && config.key != "sstring")
+        return false;
+    if (config.key_set != "random" && config.key_set != "sequential" && config.key_set != "strided")
+        return false;
+    if (config.key_set != "random" && config.key != "int")
+        return false;
+    if (config.stride == 0)
+        return false;
+    // strided ids wrap at 2^31, pool (at most capacity + absent_keys keys) would never fill up
+    if (config.key_set == "strided" && static_cast<uint64_t>(config.stride)*(config.capacity + absent_keys) > (1ull << 31))
+        return false;
+    if (config.distribution != "uniform" && config.distribution != "zipf" &&
+        config.distribution != "hotspot" && config.distribution != "latest")
+        return false;
+    if (config.theta <= 0.0 || config.theta >= 1.0)
+        return false;
+    if (config.hot_keys <= 0.0 || config.hot_keys > 1.0 || config.hot_ops < 0.0 || config.hot_ops > 1.0)
+        return false;
+    if (config.format != "text" && config.format != "csv" && config.format != "json")
+        return false;
+    if (config.seed == 0)
+        config.seed = time(nullptr);
+    return true;
+}
+
+static bool selected(const spec &config, const char *table)
+{
+    if (config.tables.empty())
+        return true;
+    for (auto &name : split(config.tables, ','))
+        if (name == table)
+            return true;
+    return false;
+}
+
+struct operation
+{
+    char type;
+    unsigned key;
+};
+
+struct plan
+{
+    unsigned preload {0};
+    unsigned fresh {0};
+    unsigned pool_size {0};
+    std::vector<operation> ops;
+};
+
+/*
+ * Random keys are drawn by generator until count distinct keys are collected.
+ */
+template<class Key, class Generator>
+static std::vector<Key> make_key_pool(unsigned count, Generator &&generator)
+{
+    std::vector<Key> pool;
+    std::unordered_set<Key> seen;
+    pool.reserve(count);
+    seen.reserve(count);
+    while (pool.size() < count)
+    {
+        Key key = generator();
+        if (seen.insert(key).second)
+            pool.push_back(std::move(key));
+    }
+    return pool;
+}
+
+/*
+ * Chooses present key for member/erase. inserted = keys inserted so far, preload keys first
+ * then fresh ones in order of inserts. Only latest looks at fresh keys.
+ */
+class key_chooser final
+{
+public:
+    key_chooser(const spec &workload_config, unsigned preload_keys)
+        : config(workload_config), preload(preload_keys),
+          zipf((config.distribution == "zipf" || config.distribution == "latest")? preload : 0, config.theta)
+    {
+    }
+
+    unsigned next(unsigned inserted)
+    {
+        if (config.distribution == "zipf")
+            return zipf.next();
+        if (config.distribution == "latest")
+        {
+            const unsigned rank = zipf.next();
+            return (rank < inserted)? (inserted - 1 - rank) : 0;
+        }
+        if (config.distribution == "hotspot")
+        {
+            const unsigned hot = std::max(1u, static_cast<unsigned>(config.hot_keys*preload));
+            if (rand_uniform() < config.hot_ops || hot >= preload)
+                return rand()%hot;
+            return hot + rand()%(preload - hot);
+        }
+        return rand()%preload;
+    }
+
+private:
+    const spec &config;
+    unsigned preload;
+    zipf_generator zipf;
+};
+
+static plan make_plan(const spec &config, unsigned preload)
+{
+    plan result;
+    result.preload = preload;
+    std::vector<char> types;
+    types.reserve(config.operations);
+    for (unsigned i = 0; i < config.operations; i++)
+    {
+        const unsigned dice = rand()%100;
+        const char type = (dice < config.inserts)? 'I' :
+                          (dice < config.inserts + config.members)? 'M' : 'E';
+        if (type == 'I')
+            result.fresh++;
+        types.push_back(type);
+    }
+    const unsigned absent_base = preload + result.fresh;
+    result.pool_size = absent_base + absent_keys;
+
+    unsigned next_fresh = preload;
+    key_chooser chooser(config, preload);
+    result.ops.reserve(config.operations);
+    for (auto type : types)
+    {
+        unsigned key;
+        if (type == 'I')
+            key = next_fresh++;
+        else
+        {
+            const bool hit = (preload > 0) && ((rand()%1000000) < config.hit_ratio*1000000);
+            key = hit? chooser.next(next_fresh) : (absent_base + rand()%absent_keys);
+        }
+        result.ops.push_back({type, key});
+    }
+    return result;
+}
+
+struct measurement
+{
+    std::string table;
+    std::string key;
+    std::string distribution;
+    float load_factor {0};
+    unsigned operations {0};
+    unsigned inserts {0};
+    unsigned members {0};
+    unsigned erases {0};
+    unsigned hits {0};
+    uint64_t time_ns {0};
+    double collisions_per_op {-1};
+    std::vector<std::pair<std::string, double>> metrics;
+
+    double ns_per_op() const
+    {
+        return operations? (time_ns*1.0/operations) : 0.0;
+    }
+};
+
+static std::vector<std::string> metric_names(const std::vector<measurement> &results)
+{
+    std::vector<std::string> names;
+    for (auto &result : results)
+        for (auto &metric : result.metrics)
+            if (std::find(names.begin(), names.end(), metric.first) == names.end())
+                names.push_back(metric.first);
+    return names;
+}
+
+static bool find_metric(const measurement &result, const std::string &name, double &value)
+{
+    for (auto &metric : result.metrics)
+        if (metric.first == name)
+        {
+            value = metric.second;
+            return true;
+        }
+    return false;
+}
+
+static void report(const spec &config, const std::vector<measurement> &results, FILE *out)
+{
+    const auto names = metric_names(results);
+
+    if (config.format == "csv")
+    {
+        fprintf(out, "table,key,distribution,load_factor,operations,inserts,members,erases,hits,time_ns,ns_per_op,collisions_per_op");
+        for (auto &name : names)
+            fprintf(out, ",%s", name.c_str());
+        fprintf(out, "\n");
+        for (auto &r : results)
+        {
+            fprintf(out, "%s,%s,%s,%.3f,%u,%u,%u,%u,%u,%lu,%.3f,%.3f", r.table.c_str(), r.key.c_str(),
+                    r.distribution.c_str(), r.load_factor, r.operations, r.inserts, r.members, r.erases, r.hits,
+                    r.time_ns, r.ns_per_op(), r.collisions_per_op);
+            for (auto &name : names)
+            {
+                double value = 0;
+                if (find_metric(r, name, value))
+                    fprintf(out, ",%.3f", value);
+                else
+                    fprintf(out, ",");
+            }
+            fprintf(out, "\n");
+        }
+    }
+    else if (config.format == "json")
+    {
+        fprintf(out, "{\n  \"spec\": {\"key\": \"%s\", \"key_set\": \"%s\", \"stride\": %u, \"mix\": \"%u:%u:%u\", \"hit_ratio\": %.3f, "
+                "\"distribution\": \"%s\", \"capacity\": %u, \"operations\": %u, \"seed\": %u},\n  \"results\": [\n",
+                config.key.c_str(), config.key_set.c_str(), config.stride, config.inserts, config.members,
+                config.erases, config.hit_ratio,
+                config.distribution.c_str(), config.capacity, config.operations, config.seed);
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            auto &r = results[i];
+            fprintf(out, "    {\"table\": \"%s\", \"key\": \"%s\", \"distribution\": \"%s\", \"load_factor\": %.3f, \"operations\": %u, "
+                    "\"inserts\": %u, \"members\": %u, \"erases\": %u, \"hits\": %u, \"time_ns\": %lu, "
+                    "\"ns_per_op\": %.3f, \"collisions_per_op\": %.3f",
+                    r.table.c_str(), r.key.c_str(), r.distribution.c_str(), r.load_factor, r.operations,
+                    r.inserts, r.members,
+                    r.erases, r.hits, r.time_ns, r.ns_per_op(), r.collisions_per_op);
+            for (auto &metric : r.metrics)
+                fprintf(out, ", \"%s\": %.3f", metric.first.c_str(), metric.second);
+            fprintf(out, "}%s\n", (i + 1 < results.size())? "," : "");
+        }
+        fprintf(out, "  ]\n}\n");
+    }
+    else
+    {
+        fprintf(out, "key = %s, key_set = %s, stride = %u, mix = %u:%u:%u, hit_ratio = %f, distribution = %s, "
+                "capacity = %u, operations = %u, seed = %u\n",
+                config.key.c_str(), config.key_set.c_str(), config.stride, config.inserts, config.members, config.erases, config.hit_ratio,
+                config.distribution.c_str(), config.capacity, config.operations, config.seed);
+        for (auto &r : results)
+        {
+            fprintf(out, "%-28s load = %.3f, time = %lu ms, ns/op = %.1f, hits = %u, collisions/op = %.2f",
+                    r.table.c_str(), r.load_factor, r.time_ns/1000000, r.ns_per_op(), r.hits,
+                    r.collisions_per_op);
+            for (auto &metric : r.metrics)
+                fprintf(out, ", %s = %.2f", metric.first.c_str(), metric.second);
+            fprintf(out, "\n");
+        }
+    }
+}
+
+/*
+ * Baseline is csv written by report(). Only table, key, distribution, load_factor, operations
+ * and time_ns columns are needed.
+ */
+static bool read_baseline(const std::string &path, std::vector<measurement> &baseline)
+{
+    FILE *in = fopen(path.c_str(), "r");
+    if (!in)
+        return false;
+
+    char line[4096];
+    std::vector<std::string> header;
+    while (fgets(line, sizeof line, in))
+    {
+        std::string row(line);
+        while (!row.empty() && (row.back() == '\n' || row.back() == '\r'))
+            row.pop_back();
+        auto columns = split(row, ',');
+        if (header.empty())
+        {
+            header = columns;
+            continue;
+        }
+        measurement m;
+        for (size_t i = 0; i < columns.size() && i < header.size(); i++)
+        {
+            if (header[i] == "table")
+                m.table = columns[i];
+            else if (header[i] == "key")
+                m.key = columns[i];
+            else if (header[i] == "distribution")
+                m.distribution = columns[i];
+            else if (header[i] == "load_factor")
+                m.load_factor = std::stof(columns[i]);
+            else if (header[i] == "operations")
+                m.operations = std::stoul(columns[i]);
+            else if (header[i] == "time_ns")
+                m.time_ns = std::stoull(columns[i]);
+        }
+        baseline.push_back(m);
+    }
+    fclose(in);
+    return !header.empty();
+}
+
+/*
+ * Returns number of regressions: rows slower then baseline by more then threshold.
+ */
+static unsigned compare(const spec &config, const std::vector<measurement> &results,
+                        const std::vector<measurement> &baseline)
+{
+    unsigned regressions = 0;
+    for (auto &r : results)
+    {
+        for (auto &b : baseline)
+        {
+            if (b.table != r.table || b.key != r.key || b.distribution != r.distribution ||
+                std::fabs(b.load_factor - r.load_factor) > 0.0005f)
+                continue;
+
+            const double ratio = r.ns_per_op()/b.ns_per_op();
+            const bool regression = ratio > (1.0 + config.threshold);
+            if (regression)
+                regressions++;
+            printf("%-10s %-28s load = %.3f, ns/op = %.1f, baseline ns/op = %.1f, ratio = %.3f\n",
+                   regression? "REGRESSION" : (ratio < (1.0 - config.threshold))? "improved" : "ok",
+                   r.table.c_str(), r.load_factor, r.ns_per_op(), b.ns_per_op(), ratio);
+        }
+    }
+    return regressions;
+}
+
+}
+
+#endif // WORKLOAD_HPP